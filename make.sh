@@ -41,6 +41,11 @@
 # - A compatible MinGW toolchain (e.g., x86_64-w64-mingw32) installed.
 # - The resources.rc file should be present for compilation.
 # - The miniz library source (miniz.c) should be available.
+# - unzip and a host C++17 compiler (HOST_CXX) for the payload packer, only if
+#   REPACK_PAYLOAD or PAYLOAD_INDEX is enabled or RUNTIME_MODULES is set.
+# - unzip, GNU tar and the lz4 command line tool, only if PAYLOAD_FORMAT is lz4.
+# - gzip and od, only if TRUSTED_PAYLOAD is enabled.
+# - A Windows JDK in JAVA_HOME (for jni.h), only if JNI_LAUNCH is enabled.
 # - A Windows build environment with the necessary dependencies such as
 #   - appropriate system headers and libraries.
 #
@@ -50,6 +55,16 @@
 #
 #   ./makefile.sh
 #
+# Run it with the 'bench' argument to also build the benchmark harness
+# (wjl-bench.exe), which measures the extraction and cleanup paths:
+#
+#   ./makefile.sh bench
+#
+# Run it with the 'packer' argument to build only the payload packer
+# (build/host/wjl-pack), which runs on the build machine:
+#
+#   ./makefile.sh packer
+#
 # Ensure that all required dependencies are in place before execution.
 #
 ################################################################################
@@ -58,8 +73,9 @@
 # Environment Check
 # ==============================================================================
 
-# Check if MinGW toolchain is available
-if ! command -v x86_64-w64-mingw32-g++ &> /dev/null
+# Check if MinGW toolchain is available (not needed for the packer alone,
+# which is built with the host compiler)
+if [ "$1" != "packer" ] && ! command -v x86_64-w64-mingw32-g++ > /dev/null 2>&1
 then
     echo "Error: MinGW toolchain (x86_64-w64-mingw32-g++) not found. Please install it and try again."
     exit 1
@@ -75,6 +91,8 @@ OUTPUT_DIR=./build
 # Define the source directory for the project files
 SOURCE_DIR=./src
 MINIZ_DIR=./src/miniz
+LZ4_DIR=./src/lz4
+CRC32_DIR=./src/crc32
 
 # Define wrapper executable
 WRAPPER_APP_EXE="MyWrapperApp.exe"
@@ -82,6 +100,69 @@ WRAPPER_APP_EXE="MyWrapperApp.exe"
 # Debug mode (set to 1 for debugging or 0 for release)
 DEBUG_MODE=0
 
+# Define the directory of the app resources to bundle
+APP_DIR=./app
+
+# Staging directory for repacked payloads
+STAGE_DIR=$OUTPUT_DIR/stage
+
+# Compiler for the build tools that run on the build machine (wjl-pack)
+HOST_CXX=${HOST_CXX:-c++}
+
+# Threads of the payload packer (0 for one per core)
+PACK_THREADS=0
+
+# Repack app.zip and runtime.zip with a per-entry compression policy
+# (set to 1 to enable or 0 to embed the zips as they are)
+REPACK_PAYLOAD=0
+
+# Files larger than this size (in KB) are stored without compression
+STORE_THRESHOLD_KB=1024
+
+# Files with these suffixes are already compressed and always stored
+STORE_SUFFIXES=".jar:.zip:.jmod:.gz:.png:.jpg:.gif:.ico"
+
+# Format of the embedded app and runtime contents: 'zip' embeds the zips
+# (inflated with miniz), 'lz4' converts them to LZ4 compressed tar archives,
+# which decompress several times faster at a somewhat lower ratio
+PAYLOAD_FORMAT=zip
+
+# LZ4 compression level (1-12, higher levels only slow down the build)
+LZ4_LEVEL=9
+
+# Split rarely used parts of the runtime into separately embedded modules,
+# of which the launcher extracts only those listed in IDS_RUNTIME_PROFILE
+# (resources.rc). Modules are separated by ';', each module is a name followed
+# by ':' and comma-separated shell patterns matched against the paths in
+# runtime.zip, e.g.:
+#   "desktop:runtime/bin/awt.dll,runtime/bin/fontmanager.dll,runtime/bin/freetype.dll;legal:runtime/legal/*"
+# Files matched by no module remain in the base runtime (empty to disable)
+RUNTIME_MODULES=""
+
+# Trust the embedded payload: the launcher verifies one CRC-32 per archive,
+# computed here, instead of the CRC-32 of every extracted entry (set to 1 to
+# enable; meant for executables that are signed after the build)
+TRUSTED_PAYLOAD=0
+
+# Embed an extraction index next to each zip payload (paths, sizes, offsets and
+# boot set priority resolved at build time), from which the launcher schedules
+# the extraction instead of parsing the central directory (set to 1 to enable;
+# requires the host compiler, see HOST_CXX)
+PAYLOAD_INDEX=0
+
+# Tuning profile: a text file with JVM options for this deployment, one per
+# line ('#' starts a comment, $APPDIR and $ROOTDIR are replaced), e.g.
+#   -XX:TieredStopAtLevel=1
+#   -Xmx512m
+# The launcher passes them to the JVM in addition to the options of the
+# jpackage image (empty for none)
+TUNING_PROFILE=""
+
+# Host the JVM in the launcher process through JNI instead of starting the
+# jpackage executable (set to 1 to enable; requires JAVA_HOME to point to a
+# Windows JDK, whose include directory provides jni.h)
+JNI_LAUNCH=0
+
 # ==============================================================================
 # Clean Argument
 # ==============================================================================
@@ -98,12 +179,394 @@ if [ "$1" = "clean" ]; then
 fi
 
 # ==============================================================================
-# Compilation and Linking
+# Bench Argument
+# ==============================================================================
+
+# Build the benchmark harness next to the wrapper executable
+BUILD_BENCH=0
+BENCH_EXE="wjl-bench.exe"
+if [ "$1" = "bench" ]; then
+    BUILD_BENCH=1
+fi
+
+# ==============================================================================
+# Payload Packer
+# ==============================================================================
+
+# The packer runs on the build machine and is built with the host compiler
+HOST_DIR=$OUTPUT_DIR/host
+PACKER_EXE=$HOST_DIR/wjl-pack
+
+# Build the payload packer (miniz, CRC-32 and src/packer) for the build machine,
+# once per build.
+PACKER_BUILT=0
+build_packer() {
+    if [ $PACKER_BUILT -eq 1 ]; then
+        return 0
+    fi
+    if ! command -v "$HOST_CXX" > /dev/null 2>&1; then
+        echo "Error: The host compiler '$HOST_CXX' is required to build the payload packer."
+        return 1
+    fi
+    mkdir -p "$HOST_DIR"
+    $HOST_CXX -O2 -DUSE_EXTERNAL_MZCRC -c $MINIZ_DIR/miniz.c -o "$HOST_DIR/miniz.o" &&
+    $HOST_CXX -O2 -DUSE_EXTERNAL_MZCRC -c $CRC32_DIR/crc32.c -o "$HOST_DIR/crc32.o" &&
+    $HOST_CXX -std=c++17 -O2 -I$MINIZ_DIR -o "$PACKER_EXE" $SOURCE_DIR/packer/packer.cpp "$HOST_DIR/miniz.o" "$HOST_DIR/crc32.o" -pthread || return 1
+    rm -f "$HOST_DIR/miniz.o" "$HOST_DIR/crc32.o"
+    PACKER_BUILT=1
+}
+
+if [ "$1" = "packer" ]; then
+    echo "Building payload packer..."
+    if ! build_packer; then
+        echo "Error: Failed to build the payload packer."
+        exit 1
+    fi
+    echo "Build complete. The payload packer is '$PACKER_EXE'."
+    exit 0
+fi
+
+# Pack a directory into a deterministic zip archive on all cores: files larger
+# than the threshold and files with one of the STORE_SUFFIXES are stored, all
+# other files are deflated at maximum level (stored if they do not shrink).
+# Arguments: <directory> <destination zip> <store threshold in KB, 0 for none>
+#            [<list of the entries to pack>]
+pack_zip() {
+    if [ -n "$4" ]; then
+        "$PACKER_EXE" -j "$PACK_THREADS" -l 9 --store-threshold "$3" --store-suffixes "$STORE_SUFFIXES" --files "$4" "$1" "$2"
+    else
+        "$PACKER_EXE" -j "$PACK_THREADS" -l 9 --store-threshold "$3" --store-suffixes "$STORE_SUFFIXES" "$1" "$2"
+    fi
+}
+
+# ==============================================================================
+# Payload Preparation
 # ==============================================================================
 
+# Repack a zip archive: large and already compressed files are stored, so the
+# launcher can write them without inflating, and all other files are deflated
+# at maximum level (see pack_zip).
+# Arguments: <source zip> <destination zip (absolute path)>
+repack_zip() {
+    work="$STAGE_DIR/repack"
+    rm -rf "$work" "$2"
+    mkdir -p "$work"
+    if ! unzip -q "$1" -d "$work"; then
+        return 1
+    fi
+    pack_zip "$work" "$2" "$STORE_THRESHOLD_KB" || return 1
+    rm -rf "$work"
+}
+
+# Convert a zip archive to an LZ4 compressed tar archive. Blocks of 4 MB are
+# compressed independently, so the launcher can decode them in parallel, and
+# the content size is stored in the frame header.
+# Arguments: <source zip> <destination file (absolute path)>
+convert_zip_to_lz4() {
+    work="$STAGE_DIR/convert"
+    rm -rf "$work" "$2"
+    mkdir -p "$work/files"
+    if ! unzip -q "$1" -d "$work/files"; then
+        return 1
+    fi
+    (
+        cd "$work/files" || exit 1
+        find . -mindepth 1 | sed 's|^\./||' | LC_ALL=C sort |
+            tar --format=gnu --no-recursion --hard-dereference -cf "$work/payload.tar" -T -
+    ) || return 1
+    # lz4 only stores the content size when compressing a file, not a pipe
+    if ! lz4 -q -f "-$LZ4_LEVEL" -B7 --content-size "$work/payload.tar" "$2"; then
+        return 1
+    fi
+    rm -rf "$work"
+}
+
+# Find the runtime module a file belongs to; sets 'module' to its name.
+# Arguments: <path in runtime.zip>
+match_runtime_module() {
+    module=""
+    modules_left="$RUNTIME_MODULES;"
+    while [ -n "$modules_left" ]; do
+        spec=${modules_left%%;*}
+        modules_left=${modules_left#*;}
+        patterns_left="${spec#*:},"
+        while [ -n "$patterns_left" ]; do
+            pattern=${patterns_left%%,*}
+            patterns_left=${patterns_left#*,}
+            # The pattern is left unquoted to match it as a pattern
+            case "$1" in
+                $pattern) module=${spec%%:*}; return 0 ;;
+            esac
+        done
+    done
+    return 1
+}
+
+# Split runtime.zip into the base runtime (runtime.zip) and one archive per
+# runtime module (runtime-<name>.zip). Every archive contains all directory
+# entries, so that each of them can be extracted on its own.
+# Arguments: <source zip> <destination directory (absolute path)>
+split_runtime() {
+    work="$STAGE_DIR/split-work"
+    rm -rf "$work"
+    mkdir -p "$work/files" "$work/lists" "$2"
+    if ! unzip -q "$1" -d "$work/files"; then
+        return 1
+    fi
+    (
+        cd "$work/files" || exit 1
+        find . -mindepth 1 -type d | sed 's|^\./||' | LC_ALL=C sort > ../lists/directories
+        : > ../lists/base
+        for name in $RUNTIME_MODULE_NAMES; do
+            : > "../lists/module-$name"
+        done
+        find . -type f | sed 's|^\./||' | LC_ALL=C sort | while IFS= read -r file; do
+            if match_runtime_module "$file"; then
+                echo "$file" >> "../lists/module-$module"
+            else
+                echo "$file" >> ../lists/base
+            fi
+        done
+        cat ../lists/directories ../lists/base > ../lists/pack-base
+        pack_zip . "$2/runtime.zip" 0 ../lists/pack-base || exit 1
+        for name in $RUNTIME_MODULE_NAMES; do
+            echo "Runtime module '$name': $(wc -l < "../lists/module-$name") files"
+            cat ../lists/directories "../lists/module-$name" > "../lists/pack-$name"
+            pack_zip . "$2/runtime-$name.zip" 0 "../lists/pack-$name" || exit 1
+        done
+    ) || return 1
+    rm -rf "$work"
+}
+
+# Print the resource ID of a payload, see resources.h.
+# Arguments: <payload name>
+payload_resource_id() {
+    case "$1" in
+        app) awk '$2 == "IDR_APP_CONTENTS" { print $3 }' "$SOURCE_DIR/resources.h" ;;
+        runtime) awk '$2 == "IDR_RUNTIME_CONTENTS" { print $3 }' "$SOURCE_DIR/resources.h" ;;
+        *)
+            n=0
+            for name in $RUNTIME_MODULE_NAMES; do
+                if [ "runtime-$name" = "$1" ]; then
+                    echo $(( $(awk '$2 == "IDR_RUNTIME_MODULE_FIRST" { print $3 }' "$SOURCE_DIR/resources.h") + n ))
+                    return 0
+                fi
+                n=$((n + 1))
+            done
+            return 1
+            ;;
+    esac
+}
+
+# Print the CRC-32 of a file as 8 hex digits, taken from the gzip trailer.
+# Arguments: <file>
+crc32_of_file() {
+    gzip -1 -c "$1" | tail -c 8 | head -c 4 | od -An -tu1 |
+        awk '{ printf "%02x%02x%02x%02x\n", $4, $3, $2, $1 }'
+}
+
 # Create output directories if they don't exist
 mkdir -p $OUTPUT_DIR
 
+# Directory the resource compiler resolves the 'app/...' paths against
+RESOURCE_ROOT=.
+
+# Additional resource compiler flags
+RC_FLAGS=""
+
+# Payloads to embed (without extension) and the directory they are read from
+PAYLOADS="app runtime"
+PAYLOAD_DIR=$APP_DIR
+
+if [ -n "$RUNTIME_MODULES" ]; then
+    echo "Splitting runtime into modules..."
+    if ! command -v unzip > /dev/null 2>&1; then
+        echo "Error: unzip is required to split the runtime."
+        exit 1
+    fi
+    if ! build_packer; then
+        echo "Error: Failed to build the payload packer."
+        exit 1
+    fi
+    RUNTIME_MODULE_NAMES=$(echo "$RUNTIME_MODULES" | tr ';' '\n' | sed 's/:.*//' | grep -v '^$')
+    module_count=$(echo "$RUNTIME_MODULE_NAMES" | wc -l)
+    max_modules=$(awk '$2 == "MAX_RUNTIME_MODULES" { print $3 }' "$SOURCE_DIR/resources.h")
+    if [ "$module_count" -gt "$max_modules" ]; then
+        echo "Error: At most $max_modules runtime modules are supported."
+        exit 1
+    fi
+    rm -rf "$STAGE_DIR"
+    mkdir -p "$STAGE_DIR"
+    cp -R "$APP_DIR" "$STAGE_DIR/app"
+    STAGE_ABS=$(cd "$STAGE_DIR" && pwd)
+    if ! split_runtime "$APP_DIR/runtime.zip" "$STAGE_ABS/split"; then
+        echo "Error: Failed to split runtime.zip."
+        exit 1
+    fi
+    cp "$APP_DIR/app.zip" "$STAGE_ABS/split/app.zip"
+    cp "$STAGE_ABS"/split/runtime*.zip "$STAGE_ABS/app/"
+    PAYLOAD_DIR=$STAGE_ABS/split
+    for name in $RUNTIME_MODULE_NAMES; do
+        PAYLOADS="$PAYLOADS runtime-$name"
+    done
+    RESOURCE_ROOT=$STAGE_DIR
+fi
+
+if [ "$PAYLOAD_FORMAT" = "lz4" ]; then
+    echo "Converting payload to LZ4..."
+    if ! command -v unzip > /dev/null 2>&1 || ! command -v tar > /dev/null 2>&1 || ! command -v lz4 > /dev/null 2>&1; then
+        echo "Error: unzip, tar and lz4 are required for the LZ4 payload format."
+        exit 1
+    fi
+    if [ -z "$RUNTIME_MODULES" ]; then
+        rm -rf "$STAGE_DIR"
+        mkdir -p "$STAGE_DIR"
+        cp -R "$APP_DIR" "$STAGE_DIR/app"
+        STAGE_ABS=$(cd "$STAGE_DIR" && pwd)
+    fi
+    for payload in $PAYLOADS; do
+        if ! convert_zip_to_lz4 "$PAYLOAD_DIR/$payload.zip" "$STAGE_ABS/app/$payload.tar.lz4"; then
+            echo "Error: Failed to convert $payload.zip."
+            exit 1
+        fi
+    done
+    RESOURCE_ROOT=$STAGE_DIR
+    RC_FLAGS="$RC_FLAGS -DWJL_LZ4_PAYLOAD"
+elif [ $REPACK_PAYLOAD -eq 1 ]; then
+    echo "Repacking payload..."
+    if ! command -v unzip > /dev/null 2>&1; then
+        echo "Error: unzip is required to repack the payload."
+        exit 1
+    fi
+    if ! build_packer; then
+        echo "Error: Failed to build the payload packer."
+        exit 1
+    fi
+    if [ -z "$RUNTIME_MODULES" ]; then
+        rm -rf "$STAGE_DIR"
+        mkdir -p "$STAGE_DIR"
+        cp -R "$APP_DIR" "$STAGE_DIR/app"
+        STAGE_ABS=$(cd "$STAGE_DIR" && pwd)
+    fi
+    for payload in $PAYLOADS; do
+        if ! repack_zip "$PAYLOAD_DIR/$payload.zip" "$STAGE_ABS/app/$payload.zip"; then
+            echo "Error: Failed to repack $payload.zip."
+            exit 1
+        fi
+    done
+    RESOURCE_ROOT=$STAGE_DIR
+fi
+
+if [ -n "$RUNTIME_MODULES" ]; then
+    # Resource IDs of the modules and their names, see resources.h
+    module_extension=".zip"
+    if [ "$PAYLOAD_FORMAT" = "lz4" ]; then
+        module_extension=".tar.lz4"
+    fi
+    module_id=$(awk '$2 == "IDR_RUNTIME_MODULE_FIRST" { print $3 }' "$SOURCE_DIR/resources.h")
+    name_id=$(awk '$2 == "IDS_RUNTIME_MODULE_FIRST" { print $3 }' "$SOURCE_DIR/resources.h")
+    {
+        echo "// Generated by make.sh from RUNTIME_MODULES"
+        echo "STRINGTABLE"
+        echo "BEGIN"
+        i=0
+        for name in $RUNTIME_MODULE_NAMES; do
+            echo "    $((name_id + i)) \"$name\""
+            i=$((i + 1))
+        done
+        echo "END"
+        i=0
+        for name in $RUNTIME_MODULE_NAMES; do
+            echo "$((module_id + i)) RCDATA \"app/runtime-$name$module_extension\""
+            i=$((i + 1))
+        done
+    } > "$STAGE_ABS/runtime_modules.rc"
+    RC_FLAGS="$RC_FLAGS -DWJL_RUNTIME_MODULES -I$STAGE_ABS"
+fi
+
+if [ $PAYLOAD_INDEX -eq 1 ] && [ "$PAYLOAD_FORMAT" = "lz4" ]; then
+    echo "Warning: PAYLOAD_INDEX applies to zip payloads only and is ignored for PAYLOAD_FORMAT=lz4."
+    PAYLOAD_INDEX=0
+fi
+if [ $PAYLOAD_INDEX -eq 1 ]; then
+    echo "Indexing payload..."
+    if ! build_packer; then
+        echo "Error: Failed to build the payload packer."
+        exit 1
+    fi
+    if [ -z "$STAGE_ABS" ]; then
+        rm -rf "$STAGE_DIR"
+        mkdir -p "$STAGE_DIR"
+        STAGE_ABS=$(cd "$STAGE_DIR" && pwd)
+    fi
+    mkdir -p "$STAGE_ABS/payload-index"
+    # The index resolves the boot set at build time
+    boot_set=$(sed -n 's/^[[:space:]]*IDS_BOOT_SET[[:space:]]*"\(.*\)".*$/\1/p' "$SOURCE_DIR/resources.rc")
+    # Resource IDs are IDR_PAYLOAD_INDEX_BASE + resource ID, see resources.h
+    index_base=$(awk '$2 == "IDR_PAYLOAD_INDEX_BASE" { print $3 }' "$SOURCE_DIR/resources.h")
+    {
+        echo "// Generated by make.sh (PAYLOAD_INDEX)"
+        for payload in $PAYLOADS; do
+            resource_id=$(payload_resource_id "$payload") || exit 1
+            if ! "$PACKER_EXE" --make-index --boot-set "$boot_set" "$RESOURCE_ROOT/app/$payload.zip" "$STAGE_ABS/payload-index/$payload.idx"; then
+                echo "Error: Failed to index $payload.zip." >&2
+                exit 1
+            fi
+            echo "$((index_base + resource_id)) RCDATA \"payload-index/$payload.idx\""
+        done
+    } > "$STAGE_ABS/payload_index.rc" || exit 1
+    RC_FLAGS="$RC_FLAGS -DWJL_PAYLOAD_INDEX -I$STAGE_ABS"
+fi
+
+if [ -n "$TUNING_PROFILE" ]; then
+    if [ ! -f "$TUNING_PROFILE" ]; then
+        echo "Error: Tuning profile '$TUNING_PROFILE' not found."
+        exit 1
+    fi
+    if [ -z "$STAGE_ABS" ]; then
+        rm -rf "$STAGE_DIR"
+        mkdir -p "$STAGE_DIR"
+        STAGE_ABS=$(cd "$STAGE_DIR" && pwd)
+    fi
+    cp "$TUNING_PROFILE" "$STAGE_ABS/tuning-profile.txt" || exit 1
+    RC_FLAGS="$RC_FLAGS -DWJL_TUNING_PROFILE -I$STAGE_ABS"
+fi
+
+if [ $TRUSTED_PAYLOAD -eq 1 ]; then
+    echo "Computing payload checksums..."
+    if ! command -v gzip > /dev/null 2>&1 || ! command -v od > /dev/null 2>&1; then
+        echo "Error: gzip and od are required for TRUSTED_PAYLOAD."
+        exit 1
+    fi
+    if [ -z "$STAGE_ABS" ]; then
+        rm -rf "$STAGE_DIR"
+        mkdir -p "$STAGE_DIR"
+        STAGE_ABS=$(cd "$STAGE_DIR" && pwd)
+    fi
+    payload_extension=".zip"
+    if [ "$PAYLOAD_FORMAT" = "lz4" ]; then
+        payload_extension=".tar.lz4"
+    fi
+    # String IDs are IDS_RESOURCE_CHECKSUM_BASE + resource ID, see resources.h
+    checksum_base=$(awk '$2 == "IDS_RESOURCE_CHECKSUM_BASE" { print $3 }' "$SOURCE_DIR/resources.h")
+    {
+        echo "// Generated by make.sh (TRUSTED_PAYLOAD)"
+        echo "STRINGTABLE"
+        echo "BEGIN"
+        for payload in $PAYLOADS; do
+            resource_id=$(payload_resource_id "$payload") || exit 1
+            checksum=$(crc32_of_file "$RESOURCE_ROOT/app/$payload$payload_extension") || exit 1
+            echo "    $((checksum_base + resource_id)) \"$checksum\""
+        done
+        echo "END"
+    } > "$STAGE_ABS/payload_checksums.rc" || exit 1
+    RC_FLAGS="$RC_FLAGS -DWJL_PAYLOAD_CHECKSUMS -I$STAGE_ABS"
+fi
+
+# ==============================================================================
+# Compilation and Linking
+# ==============================================================================
+
 # Define compiler and linker flags
 CXX=x86_64-w64-mingw32-g++
 # Add or omit the -mwindows flag based on DEBUG_MODE
@@ -113,38 +576,89 @@ else
     CXX_FLAGS="-static-libgcc -static-libstdc++ -static -mwindows"
 fi
 INCLUDE_FLAGS="-I$MINIZ_DIR"
+# miniz uses the accelerated CRC-32 of crc32.c
+MINIZ_FLAGS="-DUSE_EXTERNAL_MZCRC"
+if [ $TRUSTED_PAYLOAD -eq 1 ]; then
+    # also affects unzipFile, which then checks the CRC-32 of each file itself
+    MINIZ_FLAGS="$MINIZ_FLAGS -DMINIZ_DISABLE_ZIP_READER_CRC32_CHECKS"
+    INCLUDE_FLAGS="$INCLUDE_FLAGS -DWJL_TRUSTED_PAYLOAD"
+fi
+if [ $PAYLOAD_INDEX -eq 1 ]; then
+    INCLUDE_FLAGS="$INCLUDE_FLAGS -DWJL_PAYLOAD_INDEX"
+fi
+if [ -n "$TUNING_PROFILE" ]; then
+    INCLUDE_FLAGS="$INCLUDE_FLAGS -DWJL_TUNING_PROFILE"
+fi
+if [ $JNI_LAUNCH -eq 1 ]; then
+    if [ ! -f "$JAVA_HOME/include/jni.h" ] || [ ! -d "$JAVA_HOME/include/win32" ]; then
+        echo "Error: JNI_LAUNCH requires JAVA_HOME to point to a Windows JDK."
+        exit 1
+    fi
+    INCLUDE_FLAGS="$INCLUDE_FLAGS -DWJL_JNI_LAUNCH -I$JAVA_HOME/include -I$JAVA_HOME/include/win32"
+fi
 
 # Step 1: Compile miniz library
 echo "Compiling miniz library..."
-if ! $CXX -c $MINIZ_DIR/miniz.c -o $OUTPUT_DIR/miniz.o; then
+if ! $CXX $MINIZ_FLAGS -c $MINIZ_DIR/miniz.c -o $OUTPUT_DIR/miniz.o; then
     echo "Error: Failed to compile miniz library."
     exit 1
 fi
 
-# Step 2: Compile resources file
+# Step 1b: Compile LZ4 frame decoder
+echo "Compiling LZ4 decoder..."
+if ! $CXX -c $LZ4_DIR/lz4dec.c -o $OUTPUT_DIR/lz4dec.o; then
+    echo "Error: Failed to compile LZ4 decoder."
+    exit 1
+fi
+
+# Step 1c: Compile CRC-32 (the SIMD code paths are selected at run time)
+echo "Compiling CRC-32..."
+if ! $CXX -O2 -DUSE_EXTERNAL_MZCRC -c $CRC32_DIR/crc32.c -o $OUTPUT_DIR/crc32.o; then
+    echo "Error: Failed to compile CRC-32."
+    exit 1
+fi
+
+# Step 2: Compile resources file (from the resource root, see above)
 echo "Compiling resources..."
-if ! x86_64-w64-mingw32-windres $SOURCE_DIR/resources.rc -o $OUTPUT_DIR/resources.o; then
+SOURCE_ABS=$(cd "$SOURCE_DIR" && pwd)
+OUTPUT_ABS=$(cd "$OUTPUT_DIR" && pwd)
+if ! (cd "$RESOURCE_ROOT" && x86_64-w64-mingw32-windres $RC_FLAGS "$SOURCE_ABS/resources.rc" -o "$OUTPUT_ABS/resources.o"); then
     echo "Error: Failed to compile resources."
     exit 1
 fi
 
 # Step 3: Compile and link the main application
 echo "Compiling and linking the main application..."
-if ! $CXX $CXX_FLAGS -o "$OUTPUT_DIR/$WRAPPER_APP_EXE" $SOURCE_DIR/main.cpp $OUTPUT_DIR/resources.o $OUTPUT_DIR/miniz.o $INCLUDE_FLAGS; then
+if ! $CXX $CXX_FLAGS -o "$OUTPUT_DIR/$WRAPPER_APP_EXE" $SOURCE_DIR/main.cpp $OUTPUT_DIR/resources.o $OUTPUT_DIR/miniz.o $OUTPUT_DIR/lz4dec.o $OUTPUT_DIR/crc32.o $INCLUDE_FLAGS -lbcrypt; then
     echo "Error: Failed to compile and link the application."
     exit 1
 fi
 
+# Step 3b: Compile and link the benchmark harness (console application)
+if [ $BUILD_BENCH -eq 1 ]; then
+    echo "Compiling and linking the benchmark harness..."
+    if ! $CXX -O2 -static-libgcc -static-libstdc++ -static -o "$OUTPUT_DIR/$BENCH_EXE" $SOURCE_DIR/bench/bench.cpp $OUTPUT_DIR/resources.o $OUTPUT_DIR/miniz.o $OUTPUT_DIR/lz4dec.o $OUTPUT_DIR/crc32.o $INCLUDE_FLAGS -lbcrypt; then
+        echo "Error: Failed to compile and link the benchmark harness."
+        exit 1
+    fi
+fi
+
 # Step 4: Cleanup - Remove intermediate object files
 echo "Cleaning up intermediate files..."
 rm -f $OUTPUT_DIR/miniz.o
+rm -f $OUTPUT_DIR/lz4dec.o
+rm -f $OUTPUT_DIR/crc32.o
 rm -f $OUTPUT_DIR/resources.o
+rm -rf "$STAGE_DIR"
 
 # ==============================================================================
 # Final Instructions
 # ==============================================================================
 
 echo "Build complete. The executable is located in the '$OUTPUT_DIR' directory."
+if [ $BUILD_BENCH -eq 1 ]; then
+    echo "Benchmark harness: '$OUTPUT_DIR/$BENCH_EXE' (run it with an optional iteration count)."
+fi
 if [ $DEBUG_MODE -eq 1 ]; then
     echo "Debug mode is enabled. Console output is available for debugging."
 else
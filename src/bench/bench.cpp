@@ -0,0 +1,310 @@
+/**
+ * WinJavaLauncher - Benchmark harness.
+ *
+ * @file bench.cpp
+ * @brief Measures the extraction and cleanup paths of the launcher.
+ *
+ * The launcher source is compiled into this program with `WJL_NO_MAIN`, so
+ * the benchmarked functions are exactly those of the launcher. Synthetic zip
+ * payloads (many tiny files and a few huge files, each stored and deflated)
+ * and the payload embedded in the resources are extracted with the serial
+ * `unzipFile` path and the parallel in-memory path, and removed again with
+ * `deleteFilesAndDirectories`. For each case the latency percentiles over all
+ * iterations and the throughput at the median latency are reported.
+ *
+ * Build it with `./make.sh bench` and run it on the target machine:
+ *
+ *   wjl-bench.exe [iterations]
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-12
+ * @version 1.0
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define WJL_NO_MAIN
+#include "../main.cpp"
+
+
+// Default number of iterations per benchmark case
+constexpr int BENCH_ITERATIONS = 5;
+
+
+/**
+ * @brief A zip payload to benchmark.
+ */
+struct BenchPayload {
+	std::string name;
+	std::shared_ptr<void> storage;  // Owns the data of synthetic payloads
+	ResourceView zip;
+	mz_uint64 bytes;   // Total uncompressed size of the files
+	mz_uint64 files;
+};
+
+/**
+ * @brief Returns the elapsed time since a performance counter value.
+ *
+ * @param start The performance counter value at the start.
+ * @return The elapsed time in milliseconds.
+ */
+double getElapsedMilliseconds(LONGLONG start) {
+	static LARGE_INTEGER frequency = {};
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	return static_cast<double>(getTimestamp() - start) * 1000.0 / static_cast<double>(frequency.QuadPart);
+}
+
+/**
+ * @brief Generates text-like file content that deflates at a typical ratio.
+ *
+ * @param size Size of the content in bytes.
+ * @param seed State of the pseudo-random generator, advanced by the call.
+ * @return The generated content.
+ */
+std::string makeBenchContent(size_t size, mz_uint32& seed) {
+	static const char* const words[] = {
+		"java", "class", "runtime", "module", "public", "static", "void", "return",
+		"import", "package", "launcher", "resource", "byte", "0x1f", "null", "\n"
+	};
+	std::string content;
+	content.reserve(size + 16);
+	while (content.size() < size) {
+		seed = seed * 1103515245 + 12345;
+		content += words[(seed >> 16) & 15];
+		content += (seed & 0x100) ? ' ' : static_cast<char>('a' + ((seed >> 24) % 26));
+	}
+	content.resize(size);
+	return content;
+}
+
+/**
+ * @brief Builds a synthetic zip payload in memory.
+ *
+ * The files are spread over up to 100 directories below `bench/`.
+ *
+ * @param name Name of the payload.
+ * @param fileCount Number of files.
+ * @param fileSize Size of each file in bytes.
+ * @param level Compression level, 0 to store the files.
+ * @return The payload.
+ * @throws std::runtime_error if the payload cannot be built.
+ */
+BenchPayload makeBenchPayload(const std::string& name, unsigned fileCount, size_t fileSize, mz_uint level) {
+	BenchPayload payload = { name, NULL, ResourceView(), 0, 0 };
+	mz_zip_archive zip;
+	memset(&zip, 0, sizeof(zip));
+	if (!mz_zip_writer_init_heap(&zip, 0, 0)) {
+		throw std::runtime_error("Failed to create payload: " + name);
+	}
+	unsigned dirCount = std::min(fileCount, 100u);
+	bool success = mz_zip_writer_add_mem(&zip, "bench/", NULL, 0, 0);
+	for (unsigned d = 0; d < dirCount && success; ++d) {
+		success = mz_zip_writer_add_mem(&zip, ("bench/d" + std::to_string(d) + "/").c_str(), NULL, 0, 0);
+	}
+	mz_uint32 seed = 42;
+	for (unsigned i = 0; i < fileCount && success; ++i) {
+		std::string content = makeBenchContent(fileSize, seed);
+		std::string fileName = "bench/d" + std::to_string(i % dirCount) + "/f" + std::to_string(i) + ".dat";
+		success = mz_zip_writer_add_mem(&zip, fileName.c_str(), content.data(), content.size(), level);
+		payload.bytes += content.size();
+		payload.files++;
+	}
+	void* buffer = NULL;
+	size_t size = 0;
+	if (!success || !mz_zip_writer_finalize_heap_archive(&zip, &buffer, &size)) {
+		mz_zip_writer_end(&zip);
+		throw std::runtime_error("Failed to create payload: " + name);
+	}
+	// The finalized archive is owned by the caller, it is released with the payload
+	payload.storage.reset(buffer, mz_free);
+	payload.zip.data = buffer;
+	payload.zip.size = static_cast<DWORD>(size);
+	mz_zip_writer_end(&zip);
+	return payload;
+}
+
+/**
+ * @brief Prints the latency percentiles and throughput of a benchmark case.
+ *
+ * @param name Name of the case.
+ * @param latencies Latency of each iteration in milliseconds.
+ * @param bytes Bytes processed per iteration, 0 to omit the throughput.
+ */
+void printBenchResult(const std::string& name, std::vector<double> latencies, mz_uint64 bytes) {
+	if (latencies.empty()) {
+		printf("%-44s skipped\n", name.c_str());
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	auto percentile = [&](double p) {
+		// Nearest-rank percentile
+		size_t rank = static_cast<size_t>(p / 100.0 * latencies.size() + 0.999999);
+		return latencies[std::min(std::max<size_t>(rank, 1), latencies.size()) - 1];
+	};
+	double median = percentile(50);
+	printf("%-44s %5zu %9.2f %9.2f %9.2f %9.2f", name.c_str(), latencies.size(), median, percentile(90), percentile(99), latencies.back());
+	if (bytes > 0 && median > 0) {
+		printf(" %9.1f", static_cast<double>(bytes) / (1024.0 * 1024.0) / (median / 1000.0));
+	}
+	printf("\n");
+}
+
+/**
+ * @brief Benchmarks an extraction function and the cleanup of its output.
+ *
+ * @param name Name of the case.
+ * @param bytes Bytes extracted per iteration.
+ * @param iterations Number of iterations.
+ * @param outputDir Directory to extract into, deleted after every iteration.
+ * @param prepare Untimed preparation before every iteration, may be empty.
+ * @param extract The extraction; receives the output directory.
+ */
+void benchmarkExtraction(const std::string& name, mz_uint64 bytes, int iterations, const std::string& outputDir,
+		const std::function<void()>& prepare, const std::function<bool(const std::string&)>& extract) {
+	std::vector<double> extractLatencies;
+	std::vector<double> cleanupLatencies;
+	for (int i = 0; i < iterations; ++i) {
+		if (prepare) {
+			prepare();
+		}
+		fs::create_directories(outputDir);
+		LONGLONG start = getTimestamp();
+		bool success = extract(outputDir);
+		double elapsed = getElapsedMilliseconds(start);
+		if (success) {
+			extractLatencies.push_back(elapsed);
+		}
+		start = getTimestamp();
+		deleteFilesAndDirectories("", outputDir);
+		cleanupLatencies.push_back(getElapsedMilliseconds(start));
+		if (!success) {
+			printErrorInfo("Extraction failed: " + name);
+			break;
+		}
+	}
+	printBenchResult(name, extractLatencies, bytes);
+	printBenchResult("  deleteFilesAndDirectories", cleanupLatencies, 0);
+}
+
+/**
+ * @brief Runs the serial and parallel extraction cases for a zip payload.
+ *
+ * @param payload The payload to extract.
+ * @param iterations Number of iterations.
+ * @param benchDir Working directory of the benchmark.
+ */
+void benchmarkPayload(const BenchPayload& payload, int iterations, const fs::path& benchDir) {
+	const std::string outputDir = (benchDir / "out").string();
+	const std::string zipPath = (benchDir / "payload.zip").string();
+	printf("\n%s: %llu files, %.1f MB, %.1f MB compressed\n", payload.name.c_str(), static_cast<unsigned long long>(payload.files),
+		payload.bytes / (1024.0 * 1024.0), payload.zip.size / (1024.0 * 1024.0));
+
+	// unzipFile deletes the zip file, so it is written again before every iteration
+	benchmarkExtraction("unzipFile (serial)", payload.bytes, iterations, outputDir,
+		[&]() { writeFileData(zipPath, payload.zip.data, payload.zip.size); },
+		[&](const std::string& dir) { unzipFile(zipPath, dir); return !fs::exists(zipPath); });
+	for (unsigned threads : { 1u, 0u }) {
+		std::string name = "parallel in-memory (" + (threads == 0 ? std::string("all cores") : std::to_string(threads) + " thread") + ")";
+		benchmarkExtraction(name, payload.bytes, iterations, outputDir, nullptr, [&](const std::string& dir) {
+			try {
+				extractZipEntriesParallel(payload.zip.data, payload.zip.size, payload.name, dir, threads, ExtractionPass::All);
+				return true;
+			} catch (const std::exception& e) {
+				printErrorInfo(e.what());
+				return false;
+			}
+		});
+	}
+}
+
+/**
+ * @brief Runs all benchmark cases.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv The command-line arguments; the optional first one is the
+ *             number of iterations per case.
+ * @return 0 on success, 1 on error.
+ */
+int main(int argc, char* argv[]) {
+	int iterations = (argc > 1) ? std::max(1, atoi(argv[1])) : BENCH_ITERATIONS;
+	try {
+		fs::path benchDir = fs::path(getTempDirectory()) / ("wjl-bench-" + std::to_string(GetCurrentProcessId()));
+		fs::create_directories(benchDir);
+		printf("%-44s %5s %9s %9s %9s %9s %9s\n", "case", "iter", "p50 ms", "p90 ms", "p99 ms", "max ms", "MB/s");
+
+		// Synthetic payloads
+		const struct { const char* name; unsigned files; size_t size; mz_uint level; } cases[] = {
+			{ "tiny files, deflated", 10000, 1024, MZ_DEFAULT_LEVEL },
+			{ "tiny files, stored", 10000, 1024, MZ_NO_COMPRESSION },
+			{ "huge files, deflated", 4, 32 * 1024 * 1024, MZ_DEFAULT_LEVEL },
+			{ "huge files, stored", 4, 32 * 1024 * 1024, MZ_NO_COMPRESSION }
+		};
+		for (const auto& c : cases) {
+			benchmarkPayload(makeBenchPayload(c.name, c.files, c.size, c.level), iterations, benchDir);
+		}
+
+		// Embedded payload
+		printf("\nembedded resources\n");
+		const ResourceView executable = getResourceView(IDR_APP_EXECUTABLE);
+		const std::string exePath = (benchDir / "app.exe").string();
+		std::vector<double> latencies;
+		for (int i = 0; i < iterations && executable; ++i) {
+			LONGLONG start = getTimestamp();
+			if (!extractResource(IDR_APP_EXECUTABLE, exePath)) {
+				break;
+			}
+			latencies.push_back(getElapsedMilliseconds(start));
+			fs::remove(exePath);
+		}
+		printBenchResult("extractResource (executable)", latencies, executable.size);
+		std::vector<UINT> resourceIDs = getRuntimeResources();
+		resourceIDs.insert(resourceIDs.begin(), IDR_APP_CONTENTS);
+		for (UINT resourceID : resourceIDs) {
+			const ResourceView resource = getResourceView(resourceID);
+			if (resource) {
+				BenchPayload payload = { "resource " + std::to_string(resourceID), NULL, resource, 0, 0 };
+				mz_zip_archive zip;
+				memset(&zip, 0, sizeof(zip));
+				if (mz_zip_reader_init_mem(&zip, resource.data, resource.size, 0)) {
+					for (mz_uint f = 0; f < mz_zip_reader_get_num_files(&zip); ++f) {
+						mz_zip_archive_file_stat stat;
+						if (mz_zip_reader_file_stat(&zip, f, &stat) && !stat.m_is_directory) {
+							payload.bytes += stat.m_uncomp_size;
+							payload.files++;
+						}
+					}
+					mz_zip_reader_end(&zip);
+					benchmarkPayload(payload, iterations, benchDir);
+				} else {
+					printf("%s is not a zip archive, skipped\n", payload.name.c_str());
+				}
+			}
+		}
+
+		fs::remove_all(benchDir);
+		return 0;
+	} catch (const std::exception& e) {
+		printErrorInfo("Benchmark failed: " + std::string(e.what()));
+		return 1;
+	}
+}
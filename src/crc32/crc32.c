@@ -0,0 +1,249 @@
+/**
+ * WinJavaLauncher - Accelerated CRC-32.
+ *
+ * @file crc32.c
+ * @brief CRC-32 (IEEE 802.3) with PCLMULQDQ, ARMv8 CRC32 and table variants.
+ *
+ * The PCLMULQDQ variant follows Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction": four 128-bit lanes are folded
+ * 64 bytes at a time, folded into a single lane, then reduced to 32 bits
+ * with a Barrett reduction. The constants are those of the reflected
+ * polynomial 0xEDB88320, as used by zlib and Chromium. The variant is
+ * compiled with function target attributes, so the rest of the launcher
+ * does not require these instructions.
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-16
+ * @version 1.0
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "crc32.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define CRC32_PCLMUL 1
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32_ARMV8 1
+#endif
+
+#define CRC32_POLYNOMIAL 0xEDB88320U  /* Reflected IEEE 802.3 polynomial */
+
+/* Updates the (not inverted) CRC register with more data */
+typedef uint32_t (*crc32_func)(uint32_t crc, const uint8_t* p, size_t n);
+
+static uint32_t crc32_tables[8][256];
+static crc32_func crc32_selected;
+static const char* crc32_selected_name;
+static int crc32_state;  /* 0: not initialized, 1: initializing, 2: ready */
+
+static uint32_t crc32_read32(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Slicing-by-8: eight table lookups per 8 bytes */
+static uint32_t crc32_table(uint32_t crc, const uint8_t* p, size_t n) {
+	while (n >= 8) {
+		uint32_t lo = crc ^ crc32_read32(p);
+		uint32_t hi = crc32_read32(p + 4);
+		crc = crc32_tables[7][lo & 0xFF] ^ crc32_tables[6][(lo >> 8) & 0xFF] ^
+			crc32_tables[5][(lo >> 16) & 0xFF] ^ crc32_tables[4][lo >> 24] ^
+			crc32_tables[3][hi & 0xFF] ^ crc32_tables[2][(hi >> 8) & 0xFF] ^
+			crc32_tables[1][(hi >> 16) & 0xFF] ^ crc32_tables[0][hi >> 24];
+		p += 8;
+		n -= 8;
+	}
+	while (n > 0) {
+		crc = (crc >> 8) ^ crc32_tables[0][(crc ^ *p++) & 0xFF];
+		--n;
+	}
+	return crc;
+}
+
+#ifdef CRC32_PCLMUL
+/* Folds a buffer of at least 64 bytes whose size is a multiple of 16 */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_fold(uint32_t crc, const uint8_t* p, size_t n) {
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_loadu_si128((const __m128i*)(p + 0x00));
+	x2 = _mm_loadu_si128((const __m128i*)(p + 0x10));
+	x3 = _mm_loadu_si128((const __m128i*)(p + 0x20));
+	x4 = _mm_loadu_si128((const __m128i*)(p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	p += 64;
+	n -= 64;
+
+	/* Fold four lanes in parallel */
+	while (n >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(p + 0x00)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(p + 0x10)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(p + 0x20)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(p + 0x30)));
+		p += 64;
+		n -= 64;
+	}
+
+	/* Fold the four lanes into one */
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	/* Fold the remaining 16-byte blocks */
+	while (n >= 16) {
+		x2 = _mm_loadu_si128((const __m128i*)p);
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		p += 16;
+		n -= 16;
+	}
+
+	/* Fold 128 to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask32);
+	x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x2 = _mm_and_si128(x1, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+	x2 = _mm_and_si128(x2, mask32);
+	x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t* p, size_t n) {
+	if (n >= 64) {
+		size_t folded = n & ~(size_t)15;
+		crc = crc32_pclmul_fold(crc, p, folded);
+		p += folded;
+		n -= folded;
+	}
+	return crc32_table(crc, p, n);
+}
+#endif
+
+#ifdef CRC32_ARMV8
+static uint32_t crc32_armv8(uint32_t crc, const uint8_t* p, size_t n) {
+	while (n >= 8) {
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		crc = __crc32d(crc, value);
+		p += 8;
+		n -= 8;
+	}
+	while (n > 0) {
+		crc = __crc32b(crc, *p++);
+		--n;
+	}
+	return crc;
+}
+#endif
+
+/* Builds the tables and selects the implementation, exactly once */
+static void crc32_init(void) {
+	int expected = 0;
+	if (!__atomic_compare_exchange_n(&crc32_state, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+		/* Another thread is initializing, which takes microseconds */
+		while (__atomic_load_n(&crc32_state, __ATOMIC_ACQUIRE) != 2) {
+		}
+		return;
+	}
+	for (uint32_t i = 0; i < 256; ++i) {
+		uint32_t crc = i;
+		for (int bit = 0; bit < 8; ++bit) {
+			crc = (crc >> 1) ^ (CRC32_POLYNOMIAL & (0U - (crc & 1)));
+		}
+		crc32_tables[0][i] = crc;
+	}
+	for (uint32_t i = 0; i < 256; ++i) {
+		for (int t = 1; t < 8; ++t) {
+			crc32_tables[t][i] = (crc32_tables[t - 1][i] >> 8) ^ crc32_tables[0][crc32_tables[t - 1][i] & 0xFF];
+		}
+	}
+
+	crc32_selected = crc32_table;
+	crc32_selected_name = "table";
+#ifdef CRC32_PCLMUL
+	unsigned int eax, ebx, ecx, edx;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1)) {
+		crc32_selected = crc32_pclmul;
+		crc32_selected_name = "pclmul";
+	}
+#elif defined(CRC32_ARMV8)
+	crc32_selected = crc32_armv8;
+	crc32_selected_name = "armv8";
+#endif
+	__atomic_store_n(&crc32_state, 2, __ATOMIC_RELEASE);
+}
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size) {
+	if (__atomic_load_n(&crc32_state, __ATOMIC_ACQUIRE) != 2) {
+		crc32_init();
+	}
+	if (data == NULL) {
+		return 0;
+	}
+	return ~crc32_selected(~crc, (const uint8_t*)data, size);
+}
+
+const char* crc32_implementation(void) {
+	if (__atomic_load_n(&crc32_state, __ATOMIC_ACQUIRE) != 2) {
+		crc32_init();
+	}
+	return crc32_selected_name;
+}
+
+#ifdef USE_EXTERNAL_MZCRC
+#include "../miniz/miniz.h"
+
+/* Replaces the table-driven mz_crc32 of miniz (see USE_EXTERNAL_MZCRC in miniz.c) */
+mz_ulong mz_crc32(mz_ulong crc, const unsigned char* ptr, size_t buf_len) {
+	return crc32_update((uint32_t)crc, ptr, buf_len);
+}
+#endif
@@ -0,0 +1,71 @@
+/**
+ * WinJavaLauncher - Accelerated CRC-32.
+ *
+ * @file crc32.h
+ * @brief CRC-32 (IEEE 802.3, as used by zip) with runtime CPU dispatch.
+ *
+ * On x86 CPUs with PCLMULQDQ and SSE4.1 the data is folded 64 bytes at a
+ * time with carry-less multiplication; AArch64 builds with the CRC32
+ * extension use its instructions. Other CPUs fall back to slicing-by-8
+ * tables. miniz uses this implementation instead of its table-driven
+ * `mz_crc32` when it is built with `USE_EXTERNAL_MZCRC`.
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-16
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Updates a CRC-32 with more data.
+ *
+ * The first call selects the implementation for the CPU; it is safe to call
+ * from several threads at once.
+ *
+ * @param crc The CRC-32 of the preceding data, 0 to start.
+ * @param data Pointer to the data.
+ * @param size Size of the data in bytes.
+ * @return The CRC-32 including `data`.
+ */
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size);
+
+/**
+ * @brief Returns the name of the implementation selected for the CPU.
+ *
+ * @return "pclmul", "armv8" or "table".
+ */
+const char* crc32_implementation(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CRC32_H */
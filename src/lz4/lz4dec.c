@@ -0,0 +1,276 @@
+/**
+ * WinJavaLauncher - LZ4 frame decoder.
+ *
+ * @file lz4dec.c
+ * @brief Minimal decoder for the LZ4 frame format.
+ *
+ * Implements the LZ4 block format and the frame format as specified in
+ * `lz4_Block_format.md` and `lz4_Frame_format.md` of the LZ4 project. All
+ * input is bounds-checked, malformed data makes the functions fail instead of
+ * reading or writing outside of the given buffers.
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-12
+ * @version 1.0
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "lz4dec.h"
+#include <string.h>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_XXH_PRIME1 2654435761U
+#define LZ4_XXH_PRIME2 2246822519U
+#define LZ4_XXH_PRIME3 3266489917U
+#define LZ4_XXH_PRIME4 668265263U
+#define LZ4_XXH_PRIME5 374761393U
+
+static uint32_t lz4_read32(const uint8_t* p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t lz4_rotl32(uint32_t x, int r) {
+	return (x << r) | (x >> (32 - r));
+}
+
+uint32_t lz4_xxh32(const void* data, size_t size, uint32_t seed) {
+	const uint8_t* p = (const uint8_t*)data;
+	const uint8_t* end = p + size;
+	uint32_t h;
+
+	if (size >= 16) {
+		const uint8_t* limit = end - 16;
+		uint32_t v1 = seed + LZ4_XXH_PRIME1 + LZ4_XXH_PRIME2;
+		uint32_t v2 = seed + LZ4_XXH_PRIME2;
+		uint32_t v3 = seed;
+		uint32_t v4 = seed - LZ4_XXH_PRIME1;
+		do {
+			v1 = lz4_rotl32(v1 + lz4_read32(p) * LZ4_XXH_PRIME2, 13) * LZ4_XXH_PRIME1;
+			v2 = lz4_rotl32(v2 + lz4_read32(p + 4) * LZ4_XXH_PRIME2, 13) * LZ4_XXH_PRIME1;
+			v3 = lz4_rotl32(v3 + lz4_read32(p + 8) * LZ4_XXH_PRIME2, 13) * LZ4_XXH_PRIME1;
+			v4 = lz4_rotl32(v4 + lz4_read32(p + 12) * LZ4_XXH_PRIME2, 13) * LZ4_XXH_PRIME1;
+			p += 16;
+		} while (p <= limit);
+		h = lz4_rotl32(v1, 1) + lz4_rotl32(v2, 7) + lz4_rotl32(v3, 12) + lz4_rotl32(v4, 18);
+	} else {
+		h = seed + LZ4_XXH_PRIME5;
+	}
+	h += (uint32_t)size;
+
+	while (end - p >= 4) {
+		h = lz4_rotl32(h + lz4_read32(p) * LZ4_XXH_PRIME3, 17) * LZ4_XXH_PRIME4;
+		p += 4;
+	}
+	while (p < end) {
+		h = lz4_rotl32(h + (*p++) * LZ4_XXH_PRIME5, 11) * LZ4_XXH_PRIME1;
+	}
+
+	h ^= h >> 15;
+	h *= LZ4_XXH_PRIME2;
+	h ^= h >> 13;
+	h *= LZ4_XXH_PRIME3;
+	h ^= h >> 16;
+	return h;
+}
+
+ptrdiff_t lz4_decompress_block(const void* src, size_t src_size, void* dst, size_t dst_capacity, const void* dict_start) {
+	const uint8_t* ip = (const uint8_t*)src;
+	const uint8_t* const iend = ip + src_size;
+	uint8_t* op = (uint8_t*)dst;
+	uint8_t* const oend = op + dst_capacity;
+	const uint8_t* const lowest = (const uint8_t*)dict_start;
+
+	for (;;) {
+		size_t length;
+		size_t offset;
+		const uint8_t* match;
+		unsigned token;
+
+		if (ip >= iend) {
+			return -1;
+		}
+		token = *ip++;
+
+		// Literals
+		length = token >> 4;
+		if (length == 15) {
+			unsigned b;
+			do {
+				if (ip >= iend) {
+					return -1;
+				}
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+		}
+		if (length > (size_t)(iend - ip) || length > (size_t)(oend - op)) {
+			return -1;
+		}
+		if (length <= 16 && iend - ip >= 16 && oend - op >= 16) {
+			memcpy(op, ip, 16);  // Short literal run with room to copy in one go
+		} else {
+			memcpy(op, ip, length);
+		}
+		op += length;
+		ip += length;
+		if (ip == iend) {
+			break;  // The last sequence has no match
+		}
+
+		// Match
+		if (iend - ip < 2) {
+			return -1;
+		}
+		offset = ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - lowest)) {
+			return -1;
+		}
+		length = token & 15;
+		if (length == 15) {
+			unsigned b;
+			do {
+				if (ip >= iend) {
+					return -1;
+				}
+				b = *ip++;
+				length += b;
+			} while (b == 255);
+		}
+		length += LZ4_MIN_MATCH;
+		if (length > (size_t)(oend - op)) {
+			return -1;
+		}
+		match = op - offset;
+		if (offset >= 8 && (size_t)(oend - op) >= length + 8) {
+			// Copy in 8 byte steps, each step only reads bytes already written
+			uint8_t* const copyEnd = op + length;
+			do {
+				memcpy(op, match, 8);
+				op += 8;
+				match += 8;
+			} while (op < copyEnd);
+			op = copyEnd;
+		} else {
+			// Overlapping match (repeated pattern) or close to the end
+			while (length--) {
+				*op++ = *match++;
+			}
+		}
+	}
+	return op - (uint8_t*)dst;
+}
+
+int lz4_frame_parse_header(const void* src, size_t src_size, lz4_frame_info* info) {
+	const uint8_t* p = (const uint8_t*)src;
+	size_t descriptorSize = 2;
+	unsigned flg;
+	unsigned bd;
+	unsigned blockSizeId;
+
+	if (src_size < 7 || lz4_read32(p) != LZ4_FRAME_MAGIC) {
+		return 0;
+	}
+	flg = p[4];
+	bd = p[5];
+	if ((flg >> 6) != 1 || (flg & 0x02) != 0 || (bd & 0x8F) != 0) {
+		return 0;  // Unknown version or reserved bits set
+	}
+	if ((flg & 0x01) != 0) {
+		return 0;  // Dictionaries are not supported
+	}
+	blockSizeId = (bd >> 4) & 0x07;
+	if (blockSizeId < 4) {
+		return 0;
+	}
+
+	memset(info, 0, sizeof(*info));
+	info->block_max_size = (size_t)1 << (8 + 2 * blockSizeId);  // 64 KB, 256 KB, 1 MB or 4 MB
+	info->independent_blocks = (flg & 0x20) != 0;
+	info->block_checksum = (flg & 0x10) != 0;
+	info->has_content_size = (flg & 0x08) != 0;
+	info->content_checksum = (flg & 0x04) != 0;
+	if (info->has_content_size) {
+		descriptorSize += 8;
+	}
+	if (src_size < 4 + descriptorSize + 1) {
+		return 0;
+	}
+	if (info->has_content_size) {
+		info->content_size = lz4_read32(p + 6) | ((uint64_t)lz4_read32(p + 10) << 32);
+	}
+	// Header checksum: second byte of the XXH32 of the descriptor
+	if (((lz4_xxh32(p + 4, descriptorSize, 0) >> 8) & 0xFF) != p[4 + descriptorSize]) {
+		return 0;
+	}
+	info->header_size = 4 + descriptorSize + 1;
+	return 1;
+}
+
+int lz4_frame_next_block(const void* src, size_t src_size, const lz4_frame_info* info, size_t* pos, lz4_frame_block* block) {
+	const uint8_t* p = (const uint8_t*)src;
+	uint32_t blockSize;
+	size_t checksumSize = info->block_checksum ? 4 : 0;
+
+	if (*pos > src_size || src_size - *pos < 4) {
+		return -1;
+	}
+	blockSize = lz4_read32(p + *pos);
+	*pos += 4;
+	if (blockSize == 0) {
+		return 0;  // End mark
+	}
+	block->compressed = (blockSize & 0x80000000U) == 0;
+	block->size = blockSize & 0x7FFFFFFFU;
+	if (block->size > info->block_max_size || src_size - *pos < block->size + checksumSize) {
+		return -1;
+	}
+	block->data = p + *pos;
+	*pos += block->size;
+	block->checksum = checksumSize != 0 ? lz4_read32(p + *pos) : 0;
+	*pos += checksumSize;
+	return 1;
+}
+
+ptrdiff_t lz4_frame_decode_block(const lz4_frame_info* info, const lz4_frame_block* block, void* dst, size_t dst_capacity, const void* dict_start) {
+	if (info->block_checksum && lz4_xxh32(block->data, block->size, 0) != block->checksum) {
+		return -1;
+	}
+	if (!block->compressed) {
+		if (block->size > dst_capacity) {
+			return -1;
+		}
+		memcpy(dst, block->data, block->size);
+		return (ptrdiff_t)block->size;
+	}
+	return lz4_decompress_block(block->data, block->size, dst, dst_capacity, dict_start);
+}
+
+int lz4_frame_verify_content(const void* src, size_t src_size, const lz4_frame_info* info, size_t pos, const void* content, size_t content_size) {
+	if (!info->content_checksum) {
+		return 1;
+	}
+	if (pos > src_size || src_size - pos < 4) {
+		return 0;
+	}
+	return lz4_xxh32(content, content_size, 0) == lz4_read32((const uint8_t*)src + pos);
+}
@@ -0,0 +1,146 @@
+/**
+ * WinJavaLauncher - LZ4 frame decoder.
+ *
+ * @file lz4dec.h
+ * @brief Minimal decoder for the LZ4 frame format (LZ4 v1.6.0+ frames).
+ *
+ * Only decoding is implemented, as the payload is produced at build time by
+ * the `lz4` command line tool. The frame is walked block by block, so that
+ * independent blocks can be decoded by several threads at once.
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-12
+ * @version 1.0
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef LZ4DEC_H
+#define LZ4DEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Magic number at the start of an LZ4 frame (little endian). */
+#define LZ4_FRAME_MAGIC 0x184D2204U
+
+/** Information from an LZ4 frame descriptor. */
+typedef struct lz4_frame_info {
+	uint64_t content_size;      /**< Decoded size, 0 if not stored in the frame */
+	size_t block_max_size;      /**< Maximum decoded size of a block */
+	int has_content_size;       /**< Non-zero if content_size is valid */
+	int independent_blocks;     /**< Non-zero if blocks do not reference each other */
+	int block_checksum;         /**< Non-zero if each block carries an XXH32 checksum */
+	int content_checksum;       /**< Non-zero if the frame ends with an XXH32 checksum */
+	size_t header_size;         /**< Size of the magic number and frame descriptor */
+} lz4_frame_info;
+
+/** A data block of an LZ4 frame. */
+typedef struct lz4_frame_block {
+	const uint8_t* data;        /**< Block data within the frame */
+	size_t size;                /**< Size of the block data */
+	int compressed;             /**< Zero if the data is stored uncompressed */
+	uint32_t checksum;          /**< XXH32 of the block data, if block_checksum is set */
+} lz4_frame_block;
+
+/**
+ * @brief Computes the XXH32 hash of a buffer.
+ *
+ * @param data Pointer to the data.
+ * @param size Size of the data in bytes.
+ * @param seed The hash seed (0 for LZ4 checksums).
+ * @return The 32-bit hash value.
+ */
+uint32_t lz4_xxh32(const void* data, size_t size, uint32_t seed);
+
+/**
+ * @brief Decodes a single LZ4 compressed block.
+ *
+ * Matches may reference decoded data before `dst` down to `dict_start`,
+ * which allows linked blocks to be decoded into one contiguous buffer. For
+ * independent blocks `dict_start` equals `dst`.
+ *
+ * @param src Pointer to the compressed block.
+ * @param src_size Size of the compressed block in bytes.
+ * @param dst Destination buffer.
+ * @param dst_capacity Size of the destination buffer in bytes.
+ * @param dict_start Lowest address a match may reference.
+ * @return The number of decoded bytes, or -1 if the block is malformed.
+ */
+ptrdiff_t lz4_decompress_block(const void* src, size_t src_size, void* dst, size_t dst_capacity, const void* dict_start);
+
+/**
+ * @brief Parses the header of an LZ4 frame.
+ *
+ * @param src Pointer to the frame.
+ * @param src_size Size of the frame in bytes.
+ * @param info Receives the frame information.
+ * @return Non-zero on success, zero if the header is invalid or unsupported.
+ */
+int lz4_frame_parse_header(const void* src, size_t src_size, lz4_frame_info* info);
+
+/**
+ * @brief Reads the next block of an LZ4 frame.
+ *
+ * @param src Pointer to the frame.
+ * @param src_size Size of the frame in bytes.
+ * @param info The frame information.
+ * @param pos Offset of the block within the frame, advanced past the block.
+ *            Start with `info->header_size`.
+ * @param block Receives the block.
+ * @return 1 if a block was read, 0 at the end mark, -1 if the frame is truncated.
+ */
+int lz4_frame_next_block(const void* src, size_t src_size, const lz4_frame_info* info, size_t* pos, lz4_frame_block* block);
+
+/**
+ * @brief Decodes a block of an LZ4 frame, verifying its checksum if present.
+ *
+ * @param info The frame information.
+ * @param block The block to decode.
+ * @param dst Destination buffer.
+ * @param dst_capacity Size of the destination buffer in bytes.
+ * @param dict_start Lowest address a match may reference (see lz4_decompress_block).
+ * @return The number of decoded bytes, or -1 on error.
+ */
+ptrdiff_t lz4_frame_decode_block(const lz4_frame_info* info, const lz4_frame_block* block, void* dst, size_t dst_capacity, const void* dict_start);
+
+/**
+ * @brief Verifies the content checksum at the end of an LZ4 frame.
+ *
+ * @param src Pointer to the frame.
+ * @param src_size Size of the frame in bytes.
+ * @param info The frame information.
+ * @param pos Offset just after the end mark.
+ * @param content Pointer to the decoded content.
+ * @param content_size Size of the decoded content in bytes.
+ * @return Non-zero if the checksum matches or the frame has none.
+ */
+int lz4_frame_verify_content(const void* src, size_t src_size, const lz4_frame_info* info, size_t pos, const void* content, size_t content_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LZ4DEC_H
@@ -36,13 +36,31 @@
 
 #include "resources.h"    // Ensure this includes the resource IDs
 #include "miniz/miniz.h"  // Include the miniz header for zip functionality
+#include "lz4/lz4dec.h"    // LZ4 frame decoder for the alternative payload format
+#include "crc32/crc32.h"  // Accelerated CRC-32, also used by miniz (USE_EXTERNAL_MZCRC)
+#include "payload_index.h" // Extraction index generated by make.sh (PAYLOAD_INDEX=1)
 #include <windows.h>
+#include <evntprov.h>     // ETW provider API for the TraceLogging events
+#include <bcrypt.h>       // CNG hashing (SHA-256) for the content keys
 #include <string>
 #include <stdexcept>      // For runtime_error
 #include <fstream>
+#include <iterator>       // For istreambuf_iterator
 #include <iostream>
 #include <filesystem>     // C++17 standard library to handle directories
 #include <vector>
+#include <cstdio>         // For snprintf
+#include <algorithm>
+#include <cctype>         // For tolower
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <chrono>
+#ifdef WJL_JNI_LAUNCH
+#include <jni.h>          // JNI invocation API of the JDK (make.sh JNI_LAUNCH=1)
+#endif
 
 namespace fs = std::filesystem;
 
@@ -53,9 +71,232 @@ constexpr bool DEBUG_MODE = false;
 // Switch for determining the resource extraction location
 constexpr bool USE_TEMP_DIRECTORY = true;
 
-// In-memory execution; it is not implemented!
-// true to enable in-memory execution, false to disable
-constexpr bool IN_MEMORY_EXECUTION = false;
+// Mark the extracted files as not to be content-indexed, so that the search
+// indexer and its property handlers leave them alone
+constexpr bool MARK_NOT_INDEXED = true;
+
+// Temporary file extraction: create the extracted files with
+// FILE_ATTRIBUTE_TEMPORARY, a hint that lets the cache manager delay writing
+// them back while memory is available, as they are deleted when the
+// application exits. The files are still created and closed one by one (and
+// scanned on access), and pages written through mapped views (the
+// MemoryMapped backend) are flushed by the mapped page writer regardless
+// true to create temporary files, false to create normal files
+constexpr bool TEMPORARY_FILE_EXTRACTION = false;
+
+// Extraction cache: keep the extracted resources in a directory keyed by the
+// content hash of the embedded payload and reuse it on later launches
+// true to enable the cache, false to extract and delete on every launch
+constexpr bool USE_EXTRACTION_CACHE = false;
+
+// Marker file written into a cache directory once it is completely extracted
+const std::string CACHE_MARKER_FILE = ".complete";
+
+// Length of the content keys naming the cache directories and the runtime
+// store: 64 bits of a SHA-256; earlier versions used 8 digits (CRC-32)
+constexpr size_t CONTENT_KEY_LENGTH = 16;
+constexpr size_t LEGACY_CONTENT_KEY_LENGTH = 8;
+
+// Delta extraction: populate a new cache directory from the one of the previous
+// payload version, rewriting only the entries whose CRC-32 or size changed
+// true to enable delta extraction, false to always extract the whole payload
+constexpr bool DELTA_EXTRACTION = true;
+
+// Manifest of the zip entries in a cache directory (used by DELTA_EXTRACTION)
+const std::string MANIFEST_FILE = ".manifest";
+
+// AppCDS: the first launch from a cache directory records the loaded classes
+// into a dynamic class data sharing archive (-XX:ArchiveClassesAtExit), later
+// launches map it (-XX:SharedArchiveFile); requires a JDK 13+ runtime
+// true to enable AppCDS, false to start the JVM without an application archive
+constexpr bool USE_APPCDS = false;
+
+// Class data sharing archive, kept in the cache directory next to the runtime
+const std::string CDS_ARCHIVE_FILE = "app.jsa";
+
+// Held by the launch that creates the archive, so that only one launch at a
+// time trains; deleted when it is closed
+const std::string CDS_LOCK_FILE = "app.jsa.lock";
+
+// The archive only pays off when it is reused by later launches
+static_assert(!USE_APPCDS || USE_EXTRACTION_CACHE, "USE_APPCDS requires USE_EXTRACTION_CACHE");
+
+// Number of worker threads used to extract zip resources
+// 0 to use one thread per logical processor, 1 to extract serially
+constexpr unsigned EXTRACTION_THREADS = 0;
+
+// Upper bound for worker threads (limit of WaitForMultipleObjects)
+constexpr unsigned MAX_WORKER_THREADS = MAXIMUM_WAIT_OBJECTS;
+
+// Early launch: extract only the boot set (IDS_BOOT_SET) before starting the
+// application and extract the remaining entries in the background
+// true to enable early launch, false to extract everything before launching
+constexpr bool EARLY_LAUNCH = false;
+
+// Backends for writing extracted files
+enum class WriteBackend {
+    Stdio,         // miniz's stdio based file writer
+    MemoryMapped,  // Preallocated file, inflated straight into a mapped view
+    Overlapped     // Preallocated file, written in large chunks with overlapped I/O
+};
+
+// Backend used to write the extracted files
+constexpr WriteBackend WRITE_BACKEND = WriteBackend::MemoryMapped;
+
+// Temporary files are created by the launcher's own writers, and kept files
+// must not be temporary
+static_assert(!TEMPORARY_FILE_EXTRACTION || WRITE_BACKEND != WriteBackend::Stdio, "TEMPORARY_FILE_EXTRACTION requires a write backend other than Stdio");
+static_assert(!TEMPORARY_FILE_EXTRACTION || !USE_EXTRACTION_CACHE, "TEMPORARY_FILE_EXTRACTION cannot be combined with USE_EXTRACTION_CACHE");
+
+// Shared runtime: extract the runtime contents once into a content-addressed
+// store (%LOCALAPPDATA%\WinJavaLauncher\runtimes\<hash>), shared by all
+// launchers embedding the same runtime, and link it into the run directory
+// true to share the runtime, false to extract it into every run directory
+constexpr bool SHARED_RUNTIME = false;
+
+// Location of the runtime store below %LOCALAPPDATA%
+const std::string RUNTIME_STORE_DIRECTORY = "WinJavaLauncher\\runtimes";
+
+// Days an unreferenced runtime is kept in the store after its last use
+constexpr unsigned RUNTIME_RETENTION_DAYS = 30;
+
+// Shared runtimes stay in the store, so they must not be temporary files
+static_assert(!TEMPORARY_FILE_EXTRACTION || !SHARED_RUNTIME, "TEMPORARY_FILE_EXTRACTION cannot be combined with SHARED_RUNTIME");
+
+// Hardlink duplicates: zip entries with the same CRC-32 and size are written
+// once and created as NTFS hard links to the first copy (if the file system
+// cannot link them, they are written as usual)
+// true to hardlink duplicate files, false to write every file
+constexpr bool HARDLINK_DUPLICATES = true;
+
+// Smallest file size (in bytes) for which a hard link replaces writing the data
+constexpr mz_uint64 HARDLINK_MIN_SIZE = 4096;
+
+// Confirm duplicates by comparing their compressed data as well, instead of
+// relying on the CRC-32 and size alone
+constexpr bool HARDLINK_VERIFY = true;
+
+// Size of each of the two buffers used by the overlapped write backend
+constexpr DWORD OVERLAPPED_BUFFER_SIZE = 1024 * 1024;
+
+// Zip arena: give each extraction thread's zip reader an allocator that keeps
+// freed blocks (inflate buffers, overlapped write buffers) for the next entry
+// instead of allocating and freeing them for every entry
+// true to enable the arena, false to use the default allocator of miniz
+constexpr bool USE_ZIP_ARENA = true;
+
+// Upper limit of the freed memory (in bytes) each arena keeps for reuse
+constexpr size_t ZIP_ARENA_CACHE_SIZE = 8 * 1024 * 1024;
+
+// Trusted payload: the payload is part of the signed executable, so instead of
+// checking the CRC-32 of every extracted entry (and of the LZ4 content), a
+// CRC-32 of each whole resource computed by make.sh is verified
+// (set TRUSTED_PAYLOAD=1 in make.sh, which also builds miniz without its checks;
+// zip files read from disk by unzipFile are then checked by the launcher)
+#ifdef WJL_TRUSTED_PAYLOAD
+constexpr bool TRUSTED_PAYLOAD = true;
+#else
+constexpr bool TRUSTED_PAYLOAD = false;
+#endif
+
+// Payload index: schedule the extraction of each zip resource from the index
+// make.sh embeds next to it, with sanitized UTF-16 paths, the directory tree
+// and the boot set already resolved, instead of from the central directory
+// (set PAYLOAD_INDEX=1 in make.sh, archives without a valid index fall back)
+#ifdef WJL_PAYLOAD_INDEX
+constexpr bool PAYLOAD_INDEX = true;
+#else
+constexpr bool PAYLOAD_INDEX = false;
+#endif
+
+// Tuning profile: JVM options of the deployment, embedded by make.sh
+// (TUNING_PROFILE) and passed to the JVM in addition to those of the jpackage
+// launcher configuration
+#ifdef WJL_TUNING_PROFILE
+constexpr bool TUNING_PROFILE = true;
+#else
+constexpr bool TUNING_PROFILE = false;
+#endif
+
+// Selects which zip entries an extraction pass writes
+enum class ExtractionPass {
+    All,      // All entries
+    Boot,     // Directories and the entries required to start the application
+    Deferred  // The entries not required to start the application
+};
+
+// Environment variable holding the path of the startup timing report
+const char* const TIMING_ENV_VARIABLE = "WJL_TIMING";
+
+// Command-line switch enabling the startup timing report ("--wjl-timing=<path>")
+const std::string TIMING_SWITCH = "--wjl-timing";
+
+// ETW provider of the launcher (TraceLogging events, always on); the GUID is
+// derived from the name as by TraceLoggingRegister, so trace collectors can
+// select the provider as "*WinJavaLauncher"
+const char* const ETW_PROVIDER_NAME = "WinJavaLauncher";
+const GUID ETW_PROVIDER_GUID = { 0x7a66a812, 0x633a, 0x5f68, { 0x34, 0xb4, 0xdf, 0x56, 0x7a, 0x40, 0x95, 0xdd } };
+
+// Levels of the ETW events
+constexpr UCHAR ETW_LEVEL_ERROR = 2;
+constexpr UCHAR ETW_LEVEL_INFO = 4;
+
+// Asynchronous cleanup: when the application exits, rename the run directory
+// to a tombstone and delete it in a detached low-priority process
+// true to enable asynchronous cleanup, false to delete it before exiting
+constexpr bool ASYNC_CLEANUP = false;
+
+// Name marker of directories waiting to be deleted by the purge process
+const std::string TOMBSTONE_MARKER = ".wjl-tombstone-";
+
+// Command-line switch of the detached process deleting tombstones
+const std::string PURGE_SWITCH = "--wjl-purge";
+
+// Command-line switch of the detached process deleting a directory after exit
+const std::string REMOVE_SWITCH = "--wjl-remove";
+
+// Command-line switch of the prewarm mode, run e.g. by a logon task: populate
+// the extraction cache and read the files the JVM starts from into the cache
+const std::string PREWARM_SWITCH = "--wjl-prewarm";
+
+// Files of the run directory read by the prewarm mode, besides the jpackage
+// executable, the app directory and the class data sharing archive
+const char* const PREWARM_FILES[] = {
+    "runtime\\bin\\server\\jvm.dll",
+    "runtime\\bin\\java.dll",
+    "runtime\\bin\\jimage.dll",
+    "runtime\\lib\\modules",
+    "runtime\\lib\\server\\classes.jsa"
+};
+
+// Single instance: a second launch of the application hands its arguments to
+// the running instance over a named pipe and exits instead of extracting and
+// starting the application again
+// true to enable single-instance mode, false to allow several instances
+constexpr bool SINGLE_INSTANCE = false;
+
+// Environment variable telling the application the name of the instance pipe
+const char* const INSTANCE_PIPE_VARIABLE = "WJL_INSTANCE_PIPE";
+
+// Time (in ms) a second instance waits for the pipe of the running instance
+constexpr DWORD INSTANCE_PIPE_TIMEOUT = 2000;
+
+// Time (in ms) the application has to take the arguments of a hand-off; if
+// it does not read them in time, it loses its connection to the instance pipe
+constexpr DWORD INSTANCE_DELIVERY_TIMEOUT = 500;
+
+// Upper bound of an argument frame, well above the longest command line
+constexpr size_t INSTANCE_FRAME_LIMIT = 1024 * 1024;
+
+// Process limits: the string resource IDS_PROCESS_LIMITS, or a file with this
+// extension next to the launcher (e.g. your-app.limits), configures a job
+// object, priority class, CPU affinity and EcoQoS for the application
+const std::wstring PROCESS_LIMITS_EXTENSION = L".limits";
+
+// JNI launch (WJL_JNI_LAUNCH, make.sh JNI_LAUNCH=1): host the JVM in the
+// launcher process instead of starting the jpackage executable
+// Stack size of the thread running the Java main method (as the java launcher)
+constexpr SIZE_T JVM_THREAD_STACK_SIZE = 1024 * 1024;
 
 // Define a list of unsafe file name characters to remove or replace
 const std::string unsafeChars = R"([\/:*?"<>|])";
@@ -64,16 +305,443 @@ const std::string unsafeChars = R"([\/:*?"<>|])";
 #define DEBUG_LOG(message) if (DEBUG_MODE) std::cout << "[DEBUG]: " << message << std::endl;
 
 
+/**
+ * @brief Registration of the launcher's ETW provider.
+ */
+struct EtwProvider {
+	REGHANDLE handle = 0;
+	std::vector<char> traits;  // Provider traits: the provider name in TraceLogging format
+};
+
+/**
+ * @brief Returns the process-wide ETW provider.
+ *
+ * @return The ETW provider.
+ */
+EtwProvider& getEtwProvider() {
+	static EtwProvider provider;
+	return provider;
+}
+
+/**
+ * @brief Registers the ETW provider of the launcher.
+ *
+ * The events are TraceLogging events, which carry their own metadata, so no
+ * manifest needs to be installed on the machines. As long as no trace
+ * session has enabled the provider, an event costs a flag check. The
+ * provider is unregistered when the process exits.
+ */
+void initEtw() {
+	EtwProvider& provider = getEtwProvider();
+	const size_t nameSize = strlen(ETW_PROVIDER_NAME) + 1;
+	const UINT16 traitsSize = static_cast<UINT16>(sizeof(UINT16) + nameSize);
+	provider.traits.resize(traitsSize);
+	memcpy(&provider.traits[0], &traitsSize, sizeof(traitsSize));
+	memcpy(&provider.traits[sizeof(traitsSize)], ETW_PROVIDER_NAME, nameSize);
+	if (EventRegister(&ETW_PROVIDER_GUID, NULL, NULL, &provider.handle) != ERROR_SUCCESS) {
+		provider.handle = 0;
+		return;
+	}
+	// Windows 10 reads the traits from each event; Windows 8 only from
+	// EventSetInformation, which does not exist before
+	typedef ULONG (WINAPI *EventSetInformation_t)(REGHANDLE, int, PVOID, ULONG);
+	EventSetInformation_t setInformation = reinterpret_cast<EventSetInformation_t>(
+		reinterpret_cast<void*>(GetProcAddress(GetModuleHandleW(L"advapi32.dll"), "EventSetInformation")));
+	const int eventProviderSetTraits = 2;
+	if (setInformation != NULL) {
+		setInformation(provider.handle, eventProviderSetTraits, provider.traits.data(), traitsSize);
+	}
+}
+
+/**
+ * @brief Checks whether a trace session has enabled the ETW provider.
+ *
+ * @param level The level of the event to write.
+ * @return True if events of the level are recorded.
+ */
+bool isEtwEnabled(UCHAR level) {
+	const EtwProvider& provider = getEtwProvider();
+	return provider.handle != 0 && EventProviderEnabled(provider.handle, level, 0);
+}
+
+// TraceLogging field types (the TlgIn and TlgOut values of TraceLoggingProvider.h)
+constexpr UCHAR ETW_IN_ANSISTRING = 2;
+constexpr UCHAR ETW_IN_UINT64 = 10;
+constexpr UCHAR ETW_IN_DOUBLE = 12;
+constexpr UCHAR ETW_IN_BOOL32 = 13;
+constexpr UCHAR ETW_IN_CHAIN = 0x80;  // An output type follows the input type
+constexpr UCHAR ETW_OUT_UTF8 = 35;
+
+/**
+ * @brief A TraceLogging event being built.
+ */
+struct EtwEvent {
+	UCHAR level;
+	std::vector<char> metadata;  // Size, tags, event name and the names and types of the fields
+	std::vector<char> values;    // Values of the fields
+};
+
+/**
+ * @brief Starts a TraceLogging event.
+ *
+ * @param name The event name.
+ * @param level The event level.
+ * @return The event without fields.
+ */
+EtwEvent startEtwEvent(const char* name, UCHAR level) {
+	EtwEvent event;
+	event.level = level;
+	event.metadata.resize(sizeof(UINT16) + 1);  // Size (set by writeEtwEvent) and no tags
+	event.metadata.insert(event.metadata.end(), name, name + strlen(name) + 1);
+	return event;
+}
+
+/**
+ * @brief Adds a field to a TraceLogging event.
+ *
+ * @param event The event.
+ * @param name The field name.
+ * @param type The field type, `ETW_IN_*`.
+ * @param value The field value.
+ * @param size The size of the value in bytes.
+ */
+void addEtwField(EtwEvent& event, const char* name, UCHAR type, const void* value, size_t size) {
+	event.metadata.insert(event.metadata.end(), name, name + strlen(name) + 1);
+	event.metadata.push_back(static_cast<char>(type));
+	if (type & ETW_IN_CHAIN) {
+		event.metadata.push_back(static_cast<char>(ETW_OUT_UTF8));
+	}
+	const char* bytes = static_cast<const char*>(value);
+	event.values.insert(event.values.end(), bytes, bytes + size);
+}
+
+/** @brief Adds a UTF-8 string field to a TraceLogging event. */
+void addEtwString(EtwEvent& event, const char* name, const std::string& value) {
+	addEtwField(event, name, ETW_IN_ANSISTRING | ETW_IN_CHAIN, value.c_str(), value.size() + 1);
+}
+
+/** @brief Adds an unsigned 64-bit integer field to a TraceLogging event. */
+void addEtwNumber(EtwEvent& event, const char* name, mz_uint64 value) {
+	addEtwField(event, name, ETW_IN_UINT64, &value, sizeof(value));
+}
+
+/** @brief Adds a floating-point field to a TraceLogging event. */
+void addEtwDouble(EtwEvent& event, const char* name, double value) {
+	addEtwField(event, name, ETW_IN_DOUBLE, &value, sizeof(value));
+}
+
+/** @brief Adds a Boolean field to a TraceLogging event. */
+void addEtwBool(EtwEvent& event, const char* name, bool value) {
+	const INT32 flag = value ? 1 : 0;
+	addEtwField(event, name, ETW_IN_BOOL32, &flag, sizeof(flag));
+}
+
+/**
+ * @brief Writes a TraceLogging event.
+ *
+ * @param event The event.
+ */
+void writeEtwEvent(EtwEvent& event) {
+	const EtwProvider& provider = getEtwProvider();
+	const UINT16 metadataSize = static_cast<UINT16>(event.metadata.size());
+	memcpy(&event.metadata[0], &metadataSize, sizeof(metadataSize));
+
+	EVENT_DESCRIPTOR descriptor;
+	memset(&descriptor, 0, sizeof(descriptor));
+	descriptor.Channel = 11;  // TraceLogging events
+	descriptor.Level = event.level;
+	EVENT_DATA_DESCRIPTOR data[3];
+	EventDataDescCreate(&data[0], provider.traits.data(), static_cast<ULONG>(provider.traits.size()));
+	data[0].Reserved = 2;     // EVENT_DATA_DESCRIPTOR_TYPE_PROVIDER_METADATA
+	EventDataDescCreate(&data[1], event.metadata.data(), metadataSize);
+	data[1].Reserved = 1;     // EVENT_DATA_DESCRIPTOR_TYPE_EVENT_METADATA
+	EventDataDescCreate(&data[2], event.values.data(), static_cast<ULONG>(event.values.size()));
+	EventWriteTransfer(provider.handle, &descriptor, NULL, NULL, event.values.empty() ? 2 : 3, data);
+}
+
 /**
  * @brief Print error messages to the standard error stream.
  *
  * This function is used to print error messages in a standardized way to
- * assist in debugging and logging application issues.
+ * assist in debugging and logging application issues. As the stream is not
+ * visible in a `-mwindows` build, the message is also written as the ETW
+ * event `Error`.
  *
  * @param message The error message to be displayed.
  */
 void printErrorInfo(const std::string& message) {
     std::cerr << message << std::endl;  // Always print error messages to std::cerr
+    if (isEtwEnabled(ETW_LEVEL_ERROR)) {
+        EtwEvent event = startEtwEvent("Error", ETW_LEVEL_ERROR);
+        addEtwString(event, "Message", message);
+        writeEtwEvent(event);
+    }
+}
+
+/**
+ * @brief A measured phase of the launcher.
+ */
+struct TimingRecord {
+	std::string phase;    // Phase, e.g. "inflate" or "create_process"
+	std::string name;     // Subject of the phase, e.g. the resource name
+	LONGLONG start;       // Performance counter values
+	LONGLONG end;
+	mz_uint64 bytes;      // Bytes processed, 0 if not applicable
+	mz_uint64 items;      // Files or directories processed, 0 if not applicable
+};
+
+/**
+ * @brief State of the startup timing report.
+ */
+struct TimingLog {
+	bool enabled = false;
+	std::string path;
+	LARGE_INTEGER frequency;
+	LONGLONG origin = 0;  // Performance counter value at launcher start
+	CRITICAL_SECTION lock;
+	std::vector<TimingRecord> records;
+};
+
+/**
+ * @brief Returns the process-wide startup timing state.
+ *
+ * @return The timing state.
+ */
+TimingLog& getTimingLog() {
+	static TimingLog log;
+	return log;
+}
+
+/**
+ * @brief Returns the current value of the performance counter.
+ *
+ * @return The performance counter value.
+ */
+LONGLONG getTimestamp() {
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+/**
+ * @brief Enables the startup timing report if requested.
+ *
+ * The report is enabled by the `WJL_TIMING` environment variable holding the
+ * path of the report file, or by the `--wjl-timing=<path>` command-line
+ * switch, which takes precedence. `--wjl-timing` without a path writes
+ * `<launcher>-timing.csv` next to the launcher. Reports ending in `.json`
+ * are written as JSON, all others as CSV.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv The command-line arguments.
+ */
+void initTiming(int argc, char* argv[]) {
+	TimingLog& log = getTimingLog();
+	QueryPerformanceFrequency(&log.frequency);
+	log.origin = getTimestamp();
+
+	char value[MAX_PATH];
+	DWORD length = GetEnvironmentVariableA(TIMING_ENV_VARIABLE, value, MAX_PATH);
+	if (length > 0 && length < MAX_PATH) {
+		log.path = value;
+	}
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == TIMING_SWITCH) {
+			char exePath[MAX_PATH];
+			DWORD exeLength = GetModuleFileNameA(NULL, exePath, MAX_PATH);
+			if (exeLength > 0 && exeLength < MAX_PATH) {
+				fs::path launcher(exePath);
+				log.path = (launcher.parent_path() / (launcher.stem().string() + "-timing.csv")).string();
+			}
+		} else if (arg.compare(0, TIMING_SWITCH.size() + 1, TIMING_SWITCH + "=") == 0) {
+			log.path = arg.substr(TIMING_SWITCH.size() + 1);
+		}
+	}
+	if (!log.path.empty()) {
+		InitializeCriticalSection(&log.lock);
+		log.enabled = true;
+		DEBUG_LOG("Startup timing report: " + log.path);
+	}
+}
+
+/**
+ * @brief Converts a performance counter difference to milliseconds.
+ *
+ * @param ticks The performance counter difference.
+ * @return The time in milliseconds.
+ */
+double toMilliseconds(LONGLONG ticks) {
+	const LONGLONG frequency = getTimingLog().frequency.QuadPart;
+	return frequency > 0 ? static_cast<double>(ticks) * 1000.0 / static_cast<double>(frequency) : 0.0;
+}
+
+/**
+ * @brief Records a phase in the startup timing report.
+ *
+ * The phase is also written as the ETW event `Phase`. Does nothing unless
+ * the report is enabled or a trace session records the events. May be
+ * called from any thread.
+ *
+ * @param phase The phase that was measured.
+ * @param name The subject of the phase.
+ * @param start Performance counter value at the start of the phase.
+ * @param bytes Bytes processed during the phase.
+ * @param items Files or directories processed during the phase.
+ */
+void recordTiming(const std::string& phase, const std::string& name, LONGLONG start, mz_uint64 bytes = 0, mz_uint64 items = 0) {
+	TimingLog& log = getTimingLog();
+	const bool traced = isEtwEnabled(ETW_LEVEL_INFO);
+	if (!log.enabled && !traced) {
+		return;
+	}
+	LONGLONG end = getTimestamp();
+	if (traced) {
+		EtwEvent event = startEtwEvent("Phase", ETW_LEVEL_INFO);
+		addEtwString(event, "Phase", phase);
+		addEtwString(event, "Name", name);
+		addEtwDouble(event, "StartMs", toMilliseconds(start - log.origin));
+		addEtwDouble(event, "DurationMs", toMilliseconds(end - start));
+		addEtwNumber(event, "Bytes", bytes);
+		addEtwNumber(event, "Items", items);
+		writeEtwEvent(event);
+	}
+	if (!log.enabled) {
+		return;
+	}
+	EnterCriticalSection(&log.lock);
+	log.records.push_back({ phase, name, start, end, bytes, items });
+	LeaveCriticalSection(&log.lock);
+}
+
+/**
+ * @brief Writes the ETW event `Cache` with the result of the cache lookup.
+ *
+ * @param cacheDir The cache directory.
+ * @param hit True if the cache directory was complete.
+ */
+void traceCacheLookup(const std::string& cacheDir, bool hit) {
+	if (isEtwEnabled(ETW_LEVEL_INFO)) {
+		EtwEvent event = startEtwEvent("Cache", ETW_LEVEL_INFO);
+		addEtwString(event, "Directory", cacheDir);
+		addEtwBool(event, "Hit", hit);
+		writeEtwEvent(event);
+	}
+}
+
+/**
+ * @brief Writes the ETW event `ApplicationStarted` once the application runs.
+ *
+ * `LatencyMs` is the time since the start of the launcher, the start latency
+ * the user sees apart from the JVM's own startup.
+ *
+ * @param mode "process" for the jpackage executable, "jni" for the in-process JVM.
+ * @param processId The ID of the process running the application.
+ */
+void traceApplicationStart(const char* mode, DWORD processId) {
+	if (isEtwEnabled(ETW_LEVEL_INFO)) {
+		EtwEvent event = startEtwEvent("ApplicationStarted", ETW_LEVEL_INFO);
+		addEtwString(event, "Mode", mode);
+		addEtwNumber(event, "ProcessId", processId);
+		addEtwDouble(event, "LatencyMs", toMilliseconds(getTimestamp() - getTimingLog().origin));
+		writeEtwEvent(event);
+	}
+}
+
+/**
+ * @brief Escapes a string for a double-quoted JSON or CSV field.
+ *
+ * @param value The string to escape.
+ * @param json True for JSON escaping, false for CSV escaping.
+ * @return The escaped string, without the surrounding quotes.
+ */
+std::string escapeTimingField(const std::string& value, bool json) {
+	std::string escaped;
+	for (char c : value) {
+		if (c == '"') {
+			escaped += json ? "\\\"" : "\"\"";
+		} else if (json && c == '\\') {
+			escaped += "\\\\";
+		} else if (static_cast<unsigned char>(c) >= 0x20) {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+/**
+ * @brief Appends the recorded phases to the startup timing report.
+ *
+ * Each launch is appended, so a report file collects the results of many
+ * launches. CSV reports get one row per phase (with a header row when the
+ * file is new), JSON reports one JSON object per line and launch. Times are
+ * in milliseconds since the start of the launcher.
+ */
+void writeTimingReport() {
+	TimingLog& log = getTimingLog();
+	recordTiming("total", "launcher", log.origin);
+	if (!log.enabled) {
+		return;
+	}
+
+	SYSTEMTIME now;
+	GetSystemTime(&now);
+	char launch[64];
+	snprintf(launch, sizeof(launch), "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ", now.wYear, now.wMonth, now.wDay, now.wHour, now.wMinute, now.wSecond, now.wMilliseconds);
+	const std::string pid = std::to_string(GetCurrentProcessId());
+
+	bool json = log.path.size() >= 5 && log.path.compare(log.path.size() - 5, 5, ".json") == 0;
+	bool exists = fs::exists(log.path);
+	std::ofstream report(log.path, std::ios::app);
+	if (!report) {
+		printErrorInfo("Failed to write timing report: " + log.path);
+		return;
+	}
+	report.setf(std::ios::fixed);
+	report.precision(3);
+
+	EnterCriticalSection(&log.lock);
+	if (json) {
+		report << "{\"launch\":\"" << launch << "\",\"pid\":" << pid << ",\"phases\":[";
+		for (size_t i = 0; i < log.records.size(); ++i) {
+			const TimingRecord& record = log.records[i];
+			report << (i > 0 ? "," : "") << "{\"phase\":\"" << escapeTimingField(record.phase, true)
+				<< "\",\"name\":\"" << escapeTimingField(record.name, true)
+				<< "\",\"start_ms\":" << toMilliseconds(record.start - log.origin)
+				<< ",\"duration_ms\":" << toMilliseconds(record.end - record.start)
+				<< ",\"bytes\":" << record.bytes << ",\"items\":" << record.items << "}";
+		}
+		report << "]}\n";
+	} else {
+		if (!exists) {
+			report << "launch,pid,phase,name,start_ms,duration_ms,bytes,items\n";
+		}
+		for (const TimingRecord& record : log.records) {
+			report << launch << "," << pid << "," << record.phase << ",\"" << escapeTimingField(record.name, false) << "\","
+				<< toMilliseconds(record.start - log.origin) << "," << toMilliseconds(record.end - record.start) << ","
+				<< record.bytes << "," << record.items << "\n";
+		}
+	}
+	log.records.clear();
+	LeaveCriticalSection(&log.lock);
+}
+
+/**
+ * @brief Removes the link to the shared runtime from a run directory.
+ *
+ * The `runtime` directory of a run directory is a junction into the runtime
+ * store with `SHARED_RUNTIME`. Removing the junction itself must come before
+ * deleting the run directory, so that the deletion does not follow it into
+ * the store.
+ *
+ * @param dir The run directory (or its tombstone).
+ */
+void unlinkSharedRuntime(const fs::path& dir) {
+	const fs::path link = dir / "runtime";
+	DWORD attributes = GetFileAttributesW(link.c_str());
+	if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0) {
+		RemoveDirectoryW(link.c_str());
+	}
 }
 
 /**
@@ -97,6 +765,7 @@ void deleteFilesAndDirectories(const std::string& zipPath, const std::string& ex
 		}
 		// Delete the extracted directory if it exists
 		if (!extractDir.empty() && fs::exists(extractDir)) {
+			unlinkSharedRuntime(extractDir);
 			// Attempt to remove all contents of the directory
 			std::uintmax_t removedCount = fs::remove_all(extractDir);
 			if (removedCount == 0) {
@@ -113,381 +782,4685 @@ void deleteFilesAndDirectories(const std::string& zipPath, const std::string& ex
 }
 
 /**
- * @brief Extracts a resource from the executable into memory or a file.
+ * @brief Read-only view of a resource embedded in the executable.
+ *
+ * The memory returned by `LockResource` is part of the mapped executable
+ * image and stays valid for the lifetime of the process, so views can be
+ * copied and kept freely and the data is never copied to the heap.
+ */
+struct ResourceView {
+	const void* data = NULL;
+	DWORD size = 0;
+
+	/** @brief The resource data as bytes. */
+	const mz_uint8* bytes() const { return static_cast<const mz_uint8*>(data); }
+	/** @brief True if the resource was found and is not empty. */
+	explicit operator bool() const { return data != NULL; }
+};
+
+/**
+ * @brief Locates and locks a resource embedded in the executable.
+ *
+ * This function uses the Windows resource management functions to obtain a
+ * pointer to the resource data.
+ *
+ * @param resourceID The identifier of the resource to lock.
+ * @return The view of the resource; empty if it was not found.
+ */
+ResourceView lockResource(UINT resourceID) {
+	ResourceView view;
+	LONGLONG start = getTimestamp();
+
+	// Get the current module handle (the executable itself)
+	HMODULE hModule = GetModuleHandle(NULL);
+	if (hModule == NULL) {
+		printErrorInfo("Failed to get module handle!");
+		return view;
+	}
+	DEBUG_LOG("Module handle obtained.");
+
+	HRSRC hResInfo = FindResource(hModule, MAKEINTRESOURCE(resourceID), RT_RCDATA);
+	if (hResInfo == NULL) {
+		printErrorInfo("Resource not found!");
+		return view;
+	}
+	DEBUG_LOG("Resource found.");
+
+	DWORD dwSize = SizeofResource(hModule, hResInfo);
+	if (dwSize == 0) {
+		printErrorInfo("Resource size is 0!");
+		return view;
+	}
+	DEBUG_LOG("Resource size determined.");
+
+	HGLOBAL hResData = LoadResource(hModule, hResInfo);
+	if (hResData == NULL) {
+		printErrorInfo("Failed to load resource!");
+		return view;
+	}
+	DEBUG_LOG("Resource loaded successfully.");
+
+	// Lock the resource and get the pointer to the data
+	const void* pData = LockResource(hResData);
+	if (pData == NULL) {
+		printErrorInfo("Failed to lock resource!");
+		return view;
+	}
+	DEBUG_LOG("Resource locked into memory.");
+
+	view.data = pData;
+	view.size = dwSize;
+	recordTiming("resource", "resource " + std::to_string(resourceID), start, dwSize);
+	return view;
+}
+
+/**
+ * @brief Retrieves the view of a resource embedded in the executable.
+ *
+ * The lookup is done once per resource ID, later calls (from any thread)
+ * return the cached view. Missing resources are cached as well.
+ *
+ * @param resourceID The identifier of the resource.
+ * @return The view of the resource; empty if it was not found.
+ */
+ResourceView getResourceView(UINT resourceID) {
+	static SRWLOCK lock = SRWLOCK_INIT;
+	static std::unordered_map<UINT, ResourceView> views;
+	AcquireSRWLockShared(&lock);
+	auto it = views.find(resourceID);
+	bool found = it != views.end();
+	ResourceView view = found ? it->second : ResourceView();
+	ReleaseSRWLockShared(&lock);
+	if (!found) {
+		view = lockResource(resourceID);
+		AcquireSRWLockExclusive(&lock);
+		views[resourceID] = view;
+		ReleaseSRWLockExclusive(&lock);
+	}
+	return view;
+}
+
+/**
+ * @brief Time spent creating and closing output files, summed over the threads writing them.
+ *
+ * On-access scanners and other file system filters do most of their work
+ * when a new file is created and when it is closed after writing, so this is
+ * the part of an extraction that grows with the number of files.
+ */
+struct FileCost {
+	std::atomic<LONGLONG> createTicks{0};
+	std::atomic<LONGLONG> closeTicks{0};
+	std::atomic<mz_uint64> files{0};
+};
+
+// File cost of the extraction the current thread writes files for, NULL if none
+thread_local FileCost* currentFileCost = NULL;
+
+/**
+ * @brief Creates (or truncates) an output file and preallocates its size.
+ *
+ * Setting the end of file up front lets the file system allocate the file in
+ * one go instead of growing it with every write.
+ *
+ * @param filePath Path of the file to create.
+ * @param size The final size of the file in bytes.
+ * @param flags Additional `CreateFileW` flags, e.g. `FILE_FLAG_OVERLAPPED`.
+ * @param readAccess True to open the file for reading too (needed for mapping).
+ * @return The file handle, or `INVALID_HANDLE_VALUE` on failure.
+ */
+HANDLE createPreallocatedFile(const fs::path& filePath, mz_uint64 size, DWORD flags, bool readAccess) {
+    DWORD access = GENERIC_WRITE | (readAccess ? GENERIC_READ : 0);
+    // Temporary files may stay in the file system cache until they are deleted
+    DWORD attributes = (TEMPORARY_FILE_EXTRACTION ? FILE_ATTRIBUTE_TEMPORARY : 0) | (MARK_NOT_INDEXED ? FILE_ATTRIBUTE_NOT_CONTENT_INDEXED : 0);
+    LONGLONG created = getTimestamp();
+    HANDLE hFile = CreateFileW(filePath.c_str(), access, 0, NULL, CREATE_ALWAYS, (attributes != 0 ? attributes : FILE_ATTRIBUTE_NORMAL) | flags, NULL);
+    if (hFile != INVALID_HANDLE_VALUE && size > 0) {
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        LARGE_INTEGER start;
+        start.QuadPart = 0;
+        if (!SetFilePointerEx(hFile, end, NULL, FILE_BEGIN) || !SetEndOfFile(hFile) || !SetFilePointerEx(hFile, start, NULL, FILE_BEGIN)) {
+            CloseHandle(hFile);
+            hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    if (hFile != INVALID_HANDLE_VALUE && currentFileCost != NULL) {
+        currentFileCost->createTicks += getTimestamp() - created;
+        ++currentFileCost->files;
+    }
+    return hFile;
+}
+
+/**
+ * @brief Closes an output file created by `createPreallocatedFile`.
+ *
+ * @param hFile The file handle.
+ */
+void closeOutputFile(HANDLE hFile) {
+    LONGLONG start = getTimestamp();
+    CloseHandle(hFile);
+    if (currentFileCost != NULL) {
+        currentFileCost->closeTicks += getTimestamp() - start;
+    }
+}
+
+/**
+ * @brief Records the file cost of an extraction in the startup timing report.
+ *
+ * The phases `file_create` and `file_close` end now and last as long as all
+ * threads together spent in creating and closing the files.
+ *
+ * @param name The name of the archive.
+ * @param cost The file cost of its extraction.
+ */
+void recordFileCost(const std::string& name, const FileCost& cost) {
+    if (cost.files == 0) {
+        return;
+    }
+    LONGLONG now = getTimestamp();
+    recordTiming("file_create", name, now - cost.createTicks, 0, cost.files);
+    recordTiming("file_close", name, now - cost.closeTicks, 0, cost.files);
+}
+
+/**
+ * @brief Writes a memory block to a new file with a preallocated size.
+ *
+ * @param filePath Path of the file to create.
+ * @param data Pointer to the data to write.
+ * @param size Size of the data in bytes.
+ * @return True if the file was written, false otherwise.
+ */
+bool writeFileData(const fs::path& filePath, const void* data, mz_uint64 size) {
+    HANDLE hFile = createPreallocatedFile(filePath, size, 0, false);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    const char* next = static_cast<const char*>(data);
+    bool success = true;
+    while (size > 0 && success) {
+        DWORD chunk = static_cast<DWORD>(std::min<mz_uint64>(size, 0x40000000));
+        DWORD written = 0;
+        success = WriteFile(hFile, next, chunk, &written, NULL) && written == chunk;
+        next += written;
+        size -= written;
+    }
+    closeOutputFile(hFile);
+    return success;
+}
+
+/**
+ * @brief Inflates a zip entry straight into a memory-mapped output file.
+ *
+ * The file is preallocated to the uncompressed size from the central
+ * directory and mapped, so `miniz` decompresses directly into the file
+ * cache without any intermediate buffer or CRT file I/O.
+ *
+ * @param zip The zip archive reader.
+ * @param index Index of the entry in the archive.
+ * @param size Uncompressed size of the entry.
+ * @param filePath Path of the file to create.
+ * @return True if the entry was extracted, false otherwise.
+ */
+bool extractEntryMapped(mz_zip_archive& zip, mz_uint index, mz_uint64 size, const fs::path& filePath) {
+    HANDLE hFile = createPreallocatedFile(filePath, size, 0, true);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (size == 0) {
+        // Empty files cannot be mapped
+        closeOutputFile(hFile);
+        return true;
+    }
+    bool success = false;
+    HANDLE hMapping = CreateFileMappingW(hFile, NULL, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), NULL);
+    if (hMapping != NULL) {
+        void* view = MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, static_cast<SIZE_T>(size));
+        if (view != NULL) {
+            success = mz_zip_reader_extract_to_mem(&zip, index, view, static_cast<size_t>(size), 0);
+            UnmapViewOfFile(view);
+        }
+        CloseHandle(hMapping);
+    }
+    closeOutputFile(hFile);
+    return success;
+}
+
+/**
+ * @brief Allocator of a `miniz` zip reader that recycles freed blocks.
+ *
+ * `miniz` allocates the inflate output buffer (`TINFL_LZ_DICT_SIZE`) of every
+ * entry extracted through a callback and frees it again, and the overlapped
+ * writer needs its buffers for every file. The arena rounds block sizes up
+ * to powers of two and keeps freed blocks on free lists by capacity, so the
+ * extraction loop allocates nothing in steady state. An arena serves a
+ * single reader, which is only used by one thread, and needs no locking.
+ */
+struct ZipArena {
+	std::unordered_map<size_t, std::vector<char*>> freeBlocks;  // By capacity
+	size_t cachedBytes = 0;
+
+	ZipArena() = default;
+	ZipArena(const ZipArena&) = delete;
+	ZipArena& operator=(const ZipArena&) = delete;
+	~ZipArena() {
+		for (auto& bucket : freeBlocks) {
+			for (char* block : bucket.second) {
+				free(block);
+			}
+		}
+	}
+};
+
+// Each block starts with its capacity; 16 bytes keep the alignment of malloc
+constexpr size_t ZIP_ARENA_HEADER_SIZE = 16;
+
+/**
+ * @brief `miniz` allocation callback of a `ZipArena`.
+ *
+ * @param opaque Pointer to the `ZipArena`.
+ * @param items Number of items.
+ * @param size Size of each item in bytes.
+ * @return The allocated memory, or NULL if out of memory.
+ */
+void* zipArenaAlloc(void* opaque, size_t items, size_t size) {
+	ZipArena& arena = *static_cast<ZipArena*>(opaque);
+	if (size != 0 && items > (SIZE_MAX / 2 - ZIP_ARENA_HEADER_SIZE) / size) {
+		return NULL;
+	}
+	size_t capacity = 64;
+	while (capacity < items * size) {
+		capacity <<= 1;
+	}
+	char* block = NULL;
+	auto bucket = arena.freeBlocks.find(capacity);
+	if (bucket != arena.freeBlocks.end() && !bucket->second.empty()) {
+		block = bucket->second.back();
+		bucket->second.pop_back();
+		arena.cachedBytes -= capacity;
+	} else {
+		block = static_cast<char*>(malloc(ZIP_ARENA_HEADER_SIZE + capacity));
+		if (block == NULL) {
+			return NULL;
+		}
+		*reinterpret_cast<size_t*>(block) = capacity;
+	}
+	return block + ZIP_ARENA_HEADER_SIZE;
+}
+
+/**
+ * @brief `miniz` free callback of a `ZipArena`.
+ *
+ * The block is kept for reuse unless the arena holds `ZIP_ARENA_CACHE_SIZE`
+ * bytes already.
+ *
+ * @param opaque Pointer to the `ZipArena`.
+ * @param address The memory to free, or NULL.
+ */
+void zipArenaFree(void* opaque, void* address) {
+	if (address == NULL) {
+		return;
+	}
+	ZipArena& arena = *static_cast<ZipArena*>(opaque);
+	char* block = static_cast<char*>(address) - ZIP_ARENA_HEADER_SIZE;
+	size_t capacity = *reinterpret_cast<size_t*>(block);
+	if (arena.cachedBytes + capacity > ZIP_ARENA_CACHE_SIZE) {
+		free(block);
+		return;
+	}
+	arena.freeBlocks[capacity].push_back(block);
+	arena.cachedBytes += capacity;
+}
+
+/**
+ * @brief `miniz` reallocation callback of a `ZipArena`.
+ *
+ * @param opaque Pointer to the `ZipArena`.
+ * @param address The memory to resize, or NULL.
+ * @param items Number of items.
+ * @param size Size of each item in bytes.
+ * @return The resized memory, or NULL if out of memory (`address` stays valid).
+ */
+void* zipArenaRealloc(void* opaque, void* address, size_t items, size_t size) {
+	if (address == NULL) {
+		return zipArenaAlloc(opaque, items, size);
+	}
+	size_t capacity = *reinterpret_cast<size_t*>(static_cast<char*>(address) - ZIP_ARENA_HEADER_SIZE);
+	if (size == 0 || items <= capacity / size) {
+		return address;  // Still fits
+	}
+	void* moved = zipArenaAlloc(opaque, items, size);
+	if (moved != NULL) {
+		memcpy(moved, address, capacity);
+		zipArenaFree(opaque, address);
+	}
+	return moved;
+}
+
+/**
+ * @brief Makes a zip reader allocate through an arena (with `USE_ZIP_ARENA`).
+ *
+ * Must be called before the reader is initialized; the arena must outlive
+ * the reader.
+ *
+ * @param zip The zip archive reader, zeroed and not yet initialized.
+ * @param arena The arena of the thread using the reader.
+ */
+void attachZipArena(mz_zip_archive& zip, ZipArena& arena) {
+	if (USE_ZIP_ARENA) {
+		zip.m_pAlloc = zipArenaAlloc;
+		zip.m_pFree = zipArenaFree;
+		zip.m_pRealloc = zipArenaRealloc;
+		zip.m_pAlloc_opaque = &arena;
+	}
+}
+
+/**
+ * @brief State of the double-buffered overlapped writer.
+ *
+ * While one buffer is being written asynchronously, `miniz` fills the other.
+ * The buffers come from the allocator of the zip reader, which recycles
+ * them across files when it is a `ZipArena`.
+ */
+struct OverlappedWriter {
+    HANDLE hFile;
+    mz_zip_archive* zip;  // Allocates the buffers
+    char* buffers[2];
+    DWORD lengths[2];     // Size of the pending write of each buffer
+    OVERLAPPED overlapped[2];
+    bool pending[2];
+    unsigned current;
+    DWORD capacity;
+    DWORD filled;
+    mz_uint64 fileOffset;
+    mz_uint64 size;       // Size of the file; no buffer is needed past it
+    bool failed;
+};
+
+/**
+ * @brief Waits for the pending write of one buffer of an overlapped writer.
+ *
+ * @param writer The overlapped writer.
+ * @param buffer Index of the buffer.
+ * @return True if the write succeeded or none was pending, false otherwise.
+ */
+bool waitOverlappedWrite(OverlappedWriter& writer, unsigned buffer) {
+    if (!writer.pending[buffer]) {
+        return true;
+    }
+    writer.pending[buffer] = false;
+    DWORD written = 0;
+    return GetOverlappedResult(writer.hFile, &writer.overlapped[buffer], &written, TRUE) && written == writer.lengths[buffer];
+}
+
+/**
+ * @brief Starts writing the current buffer of an overlapped writer.
+ *
+ * @param writer The overlapped writer.
+ * @return True if the write was started, false otherwise.
+ */
+bool flushOverlappedWriter(OverlappedWriter& writer) {
+    if (writer.filled == 0) {
+        return true;
+    }
+    unsigned buffer = writer.current;
+    writer.lengths[buffer] = writer.filled;
+    OVERLAPPED& overlapped = writer.overlapped[buffer];
+    ResetEvent(overlapped.hEvent);
+    overlapped.Offset = static_cast<DWORD>(writer.fileOffset);
+    overlapped.OffsetHigh = static_cast<DWORD>(writer.fileOffset >> 32);
+    if (!WriteFile(writer.hFile, writer.buffers[buffer], writer.filled, NULL, &overlapped) && GetLastError() != ERROR_IO_PENDING) {
+        return false;
+    }
+    writer.pending[buffer] = true;
+    writer.fileOffset += writer.filled;
+    writer.filled = 0;
+
+    // Switch to the other buffer once its previous write has completed
+    writer.current = 1 - buffer;
+    if (!waitOverlappedWrite(writer, writer.current)) {
+        return false;
+    }
+    if (writer.fileOffset >= writer.size) {
+        return true;  // The file is complete, e.g. a small file in a single buffer
+    }
+    if (writer.buffers[writer.current] == NULL) {
+        writer.buffers[writer.current] = static_cast<char*>(writer.zip->m_pAlloc(writer.zip->m_pAlloc_opaque, 1, writer.capacity));
+    }
+    return writer.buffers[writer.current] != NULL;
+}
+
+/**
+ * @brief `miniz` write callback of the overlapped writer.
+ *
+ * @param opaque Pointer to the `OverlappedWriter`.
+ * @param offset Offset of the data in the file (sequential).
+ * @param data Pointer to the decompressed data.
+ * @param size Size of the data in bytes.
+ * @return The number of bytes consumed; less than `size` aborts extraction.
+ */
+size_t overlappedWriteCallback(void* opaque, mz_uint64 offset, const void* data, size_t size) {
+    OverlappedWriter& writer = *static_cast<OverlappedWriter*>(opaque);
+    const char* next = static_cast<const char*>(data);
+    size_t remaining = size;
+    while (remaining > 0 && !writer.failed) {
+        if (writer.buffers[writer.current] == NULL) {
+            writer.failed = true;  // More data than the size of the entry
+            break;
+        }
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(remaining, writer.capacity - writer.filled));
+        memcpy(writer.buffers[writer.current] + writer.filled, next, chunk);
+        writer.filled += chunk;
+        next += chunk;
+        remaining -= chunk;
+        if (writer.filled == writer.capacity && !flushOverlappedWriter(writer)) {
+            writer.failed = true;
+        }
+    }
+    return writer.failed ? 0 : size;
+}
+
+/**
+ * @brief Extracts a zip entry to a preallocated file with overlapped I/O.
+ *
+ * The decompressed data is collected in large buffers which are written
+ * asynchronously, so inflating and writing overlap and far fewer write
+ * calls are issued than through the CRT's stdio buffering.
+ *
+ * @param zip The zip archive reader.
+ * @param index Index of the entry in the archive.
+ * @param size Uncompressed size of the entry.
+ * @param filePath Path of the file to create.
+ * @return True if the entry was extracted, false otherwise.
+ */
+bool extractEntryOverlapped(mz_zip_archive& zip, mz_uint index, mz_uint64 size, const fs::path& filePath) {
+    OverlappedWriter writer;
+    writer.hFile = createPreallocatedFile(filePath, size, FILE_FLAG_OVERLAPPED, false);
+    if (writer.hFile == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (size == 0) {
+        closeOutputFile(writer.hFile);
+        return true;
+    }
+    for (unsigned i = 0; i < 2; ++i) {
+        memset(&writer.overlapped[i], 0, sizeof(OVERLAPPED));
+        writer.overlapped[i].hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        writer.pending[i] = false;
+    }
+    // Small files only need buffers of their own size; the second buffer is
+    // allocated when the first one is written
+    writer.capacity = static_cast<DWORD>(std::min<mz_uint64>(size, OVERLAPPED_BUFFER_SIZE));
+    writer.zip = &zip;
+    writer.buffers[0] = static_cast<char*>(zip.m_pAlloc(zip.m_pAlloc_opaque, 1, writer.capacity));
+    writer.buffers[1] = NULL;
+    writer.current = 0;
+    writer.filled = 0;
+    writer.fileOffset = 0;
+    writer.size = size;
+    writer.failed = writer.buffers[0] == NULL || writer.overlapped[0].hEvent == NULL || writer.overlapped[1].hEvent == NULL;
+
+    bool success = !writer.failed && mz_zip_reader_extract_to_callback(&zip, index, overlappedWriteCallback, &writer, 0);
+    success = success && flushOverlappedWriter(writer);
+    success = waitOverlappedWrite(writer, 0) && success;
+    success = waitOverlappedWrite(writer, 1) && success;
+
+    for (unsigned i = 0; i < 2; ++i) {
+        if (writer.overlapped[i].hEvent != NULL) {
+            CloseHandle(writer.overlapped[i].hEvent);
+        }
+        zip.m_pFree(zip.m_pAlloc_opaque, writer.buffers[i]);
+    }
+    closeOutputFile(writer.hFile);
+    return success && writer.fileOffset == size;
+}
+
+/**
+ * @brief Extracts a zip entry to a file using the configured write backend.
+ *
+ * @param zip The zip archive reader.
+ * @param index Index of the entry in the archive.
+ * @param size Uncompressed size of the entry.
+ * @param filePath Path of the file to create.
+ * @return True if the entry was extracted, false otherwise.
+ */
+bool extractEntryToFile(mz_zip_archive& zip, mz_uint index, mz_uint64 size, const fs::path& filePath) {
+    switch (WRITE_BACKEND) {
+        case WriteBackend::MemoryMapped:
+            return extractEntryMapped(zip, index, size, filePath);
+        case WriteBackend::Overlapped:
+            return extractEntryOverlapped(zip, index, size, filePath);
+        default:
+            return mz_zip_reader_extract_to_file(&zip, index, filePath.string().c_str(), 0);
+    }
+}
+
+/**
+ * @brief Extracts a resource from the executable into a file.
+ *
+ * This function extracts a resource embedded within the executable using
+ * Windows resource management functions and writes it to a file.
+ *
+ * @param resourceID The identifier of the resource to extract.
+ * @param outputPath Path to the file where the resource will be saved.
+ * @return True if the resource was extracted, false otherwise.
+ */
+bool extractResource(UINT resourceID, const std::string& outputPath) {
+	try {
+		DEBUG_LOG("Starting resource extraction. Resource ID: " + std::to_string(resourceID));
+
+		const ResourceView resource = getResourceView(resourceID);
+		if (!resource) {
+			return false;
+		}
+
+		// Write the resource data (zip or executable) to disk if output path is specified
+		if (outputPath.empty()) {
+			throw std::invalid_argument("No output path specified for disk extraction.");
+		}
+
+		LONGLONG start = getTimestamp();
+		if (WRITE_BACKEND != WriteBackend::Stdio) {
+			// Write straight from the resource memory into a preallocated file
+			if (!writeFileData(outputPath, resource.data, resource.size)) {
+				throw std::runtime_error("Failed to write resource to file!");
+			}
+			DEBUG_LOG("Resource extracted to " + outputPath);
+		} else {
+			std::ofstream outFile(outputPath, std::ios::binary);
+			if (!outFile.is_open()) {
+				throw std::runtime_error("Failed to open output file for writing.");
+			}
+
+			outFile.write(static_cast<const char*>(resource.data), resource.size);
+			if (outFile.fail()) {
+				throw std::runtime_error("Failed to write resource to file!");
+			} else {
+				DEBUG_LOG("Resource extracted to " + outputPath);
+			}
+			outFile.close();
+		}
+		recordTiming("write", outputPath, start, resource.size, 1);
+		DEBUG_LOG("Resource extraction completed.");
+		return true;
+    } catch (const std::exception& e) {
+        printErrorInfo("Error extracting resource: " + std::string(e.what()));
+        return false;
+    }
+}
+
+/**
+ * @brief Context handed to a worker thread started by `runWorkers`.
+ */
+struct WorkerContext {
+    const std::function<void(unsigned)>* work;
+    unsigned index;
+};
+
+/**
+ * @brief Thread procedure of worker threads started by `runWorkers`.
+ *
+ * @param param Pointer to the worker's `WorkerContext`.
+ * @return Always 0.
+ */
+DWORD WINAPI workerThreadProc(LPVOID param) {
+    WorkerContext* context = static_cast<WorkerContext*>(param);
+    try {
+        (*context->work)(context->index);
+    } catch (const std::exception& e) {
+        printErrorInfo("Error in worker thread: " + std::string(e.what()));
+    }
+    return 0;
+}
+
+/**
+ * @brief Determines the number of worker threads to use.
+ *
+ * @param configured Configured number of threads, 0 for one per logical processor.
+ * @param workItems Number of work items, the result never exceeds it.
+ * @return The number of worker threads, at least 1.
+ */
+unsigned getWorkerCount(unsigned configured, size_t workItems) {
+    unsigned count = configured;
+    if (count == 0) {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        count = systemInfo.dwNumberOfProcessors;
+    }
+    count = std::min<size_t>(std::min(count, MAX_WORKER_THREADS), std::max<size_t>(workItems, 1));
+    return std::max(count, 1u);
+}
+
+/**
+ * @brief Runs a function on several threads and waits for all of them.
+ *
+ * The calling thread takes part as worker 0. The function should claim its
+ * work items dynamically (e.g. from a shared atomic counter): if a thread
+ * cannot be created, the remaining workers then still complete all work.
+ *
+ * @param count Number of workers, including the calling thread.
+ * @param work Function to run; receives the worker index.
+ */
+void runWorkers(unsigned count, const std::function<void(unsigned)>& work) {
+    std::vector<WorkerContext> contexts(count);
+    std::vector<HANDLE> threads;
+    for (unsigned i = 1; i < count; ++i) {
+        contexts[i] = { &work, i };
+        HANDLE hThread = CreateThread(NULL, 0, workerThreadProc, &contexts[i], 0, NULL);
+        if (hThread == NULL) {
+            printErrorInfo("Failed to create worker thread. Error Code: " + std::to_string(GetLastError()));
+            break;
+        }
+        threads.push_back(hThread);
+    }
+    contexts[0] = { &work, 0 };
+    workerThreadProc(&contexts[0]);
+
+    if (!threads.empty()) {
+        WaitForMultipleObjects(static_cast<DWORD>(threads.size()), threads.data(), TRUE, INFINITE);
+        for (HANDLE hThread : threads) {
+            CloseHandle(hThread);
+        }
+    }
+}
+
+/**
+ * @brief Runs independent tasks concurrently and waits for all of them.
+ *
+ * Each task runs on its own thread (the calling thread takes the first one).
+ * This is the join point of the extraction pipeline: it returns only once
+ * every task has finished.
+ *
+ * @param tasks The tasks to run; each returns true on success.
+ * @return True if all tasks succeeded, false otherwise.
+ */
+bool runTasks(const std::vector<std::function<bool()>>& tasks) {
+    std::atomic<size_t> nextTask(0);
+    std::atomic<bool> success(true);
+    runWorkers(getWorkerCount(static_cast<unsigned>(tasks.size()), tasks.size()), [&](unsigned) {
+        for (size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+            if (!tasks[i]()) {
+                success = false;
+            }
+        }
+    });
+    return success;
+}
+
+/**
+ * @brief A task running on a background thread, e.g. deferred extraction.
+ */
+struct BackgroundTask {
+    std::function<bool()> work;
+    HANDLE hThread = NULL;
+    bool success = true;
+};
+
+/**
+ * @brief Thread procedure of a `BackgroundTask`.
+ *
+ * @param param Pointer to the `BackgroundTask`.
+ * @return Always 0.
+ */
+DWORD WINAPI backgroundTaskProc(LPVOID param) {
+    BackgroundTask* task = static_cast<BackgroundTask*>(param);
+    try {
+        task->success = task->work();
+    } catch (const std::exception& e) {
+        printErrorInfo("Error in background task: " + std::string(e.what()));
+        task->success = false;
+    }
+    return 0;
+}
+
+/**
+ * @brief Starts a task on a background thread with below-normal priority.
+ *
+ * If the thread cannot be created, the task runs synchronously instead.
+ *
+ * @param task The task object; must stay alive until `waitBackgroundTask`.
+ * @param work The function to run.
+ */
+void startBackgroundTask(BackgroundTask& task, std::function<bool()> work) {
+    task.work = std::move(work);
+    task.hThread = CreateThread(NULL, 0, backgroundTaskProc, &task, 0, NULL);
+    if (task.hThread == NULL) {
+        printErrorInfo("Failed to create background thread. Error Code: " + std::to_string(GetLastError()));
+        backgroundTaskProc(&task);
+        return;
+    }
+    SetThreadPriority(task.hThread, THREAD_PRIORITY_BELOW_NORMAL);
+}
+
+/**
+ * @brief Waits for a background task, if one was started.
+ *
+ * @param task The task to wait for.
+ * @return True if the task succeeded or none was started, false otherwise.
+ */
+bool waitBackgroundTask(BackgroundTask& task) {
+    if (task.hThread != NULL) {
+        WaitForSingleObject(task.hThread, INFINITE);
+        CloseHandle(task.hThread);
+        task.hThread = NULL;
+    }
+    return task.success;
+}
+
+/**
+ * @brief Matches a zip entry name against a boot set pattern.
+ *
+ * A pattern ending with a slash matches everything below that directory.
+ * Otherwise `*` matches any sequence of characters and `?` matches a single
+ * character. Matching is case-insensitive, like the Windows file system.
+ *
+ * @param pattern The pattern to match.
+ * @param name The zip entry name, using forward slashes.
+ * @return True if the name matches the pattern, false otherwise.
+ */
+bool matchesPattern(const std::string& pattern, const std::string& name) {
+    auto lower = [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); };
+    if (!pattern.empty() && pattern.back() == '/') {
+        return name.size() >= pattern.size() &&
+               std::equal(pattern.begin(), pattern.end(), name.begin(), [&](char a, char b) { return lower(a) == lower(b); });
+    }
+    // Iterative wildcard matching with single-star backtracking
+    size_t p = 0, n = 0, star = std::string::npos, mark = 0;
+    while (n < name.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || lower(pattern[p]) == lower(name[n]))) {
+            ++p;
+            ++n;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            mark = n;
+        } else if (star != std::string::npos) {
+            p = star + 1;
+            n = ++mark;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+/**
+ * @brief Splits a semicolon-separated list.
+ *
+ * The items are trimmed and backslashes are replaced by slashes; empty items
+ * are skipped.
+ *
+ * @param list The list.
+ * @return The list of items.
+ */
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(';', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+        std::string item = list.substr(start, end - start);
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        std::replace(item.begin(), item.end(), '\\', '/');
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+        start = end + 1;
+    }
+    return items;
+}
+
+/**
+ * @brief Retrieves a semicolon-separated list from a string resource.
+ *
+ * See `splitList` for the handling of the items.
+ *
+ * @param resourceID The ID of the string resource.
+ * @return The list of items; empty if the resource is missing.
+ */
+std::vector<std::string> getStringList(UINT resourceID) {
+    char buffer[4096];
+    if (!LoadStringA(GetModuleHandle(NULL), resourceID, buffer, sizeof(buffer))) {
+        return std::vector<std::string>();
+    }
+    return splitList(buffer);
+}
+
+/**
+ * @brief Retrieves the boot set patterns from the resources.
+ *
+ * The boot set (IDS_BOOT_SET) is a semicolon-separated list of patterns for
+ * the entries required to start the application. Patterns starting with `!`
+ * exclude entries that would otherwise be matched.
+ *
+ * @return The list of patterns; empty if the resource is missing.
+ */
+std::vector<std::string> getBootSet() {
+    return getStringList(IDS_BOOT_SET);
+}
+
+/**
+ * @brief Retrieves the runtime resources to extract.
+ *
+ * make.sh can split the runtime contents (RUNTIME_MODULES) into the base
+ * runtime (IDR_RUNTIME_CONTENTS) and modules, embedded as
+ * `IDR_RUNTIME_MODULE_FIRST + n` and named by `IDS_RUNTIME_MODULE_FIRST + n`.
+ * Only the modules listed in the runtime profile (IDS_RUNTIME_PROFILE) are
+ * extracted, `*` selects all of them and `!<name>` excludes a module, e.g.
+ * `*;!legal` to keep the many small files of a `legal` module in the
+ * launcher instead of writing them at every extraction.
+ *
+ * @return The base runtime followed by the selected modules.
+ */
+std::vector<UINT> getRuntimeResources() {
+	std::vector<UINT> resources = { IDR_RUNTIME_CONTENTS };
+	const std::vector<std::string> profile = getStringList(IDS_RUNTIME_PROFILE);
+	const bool all = std::find(profile.begin(), profile.end(), "*") != profile.end();
+	char name[256];
+	for (UINT i = 0; i < MAX_RUNTIME_MODULES; ++i) {
+		if (!LoadStringA(GetModuleHandle(NULL), IDS_RUNTIME_MODULE_FIRST + i, name, sizeof(name))) {
+			break;
+		}
+		const bool excluded = std::find(profile.begin(), profile.end(), "!" + std::string(name)) != profile.end();
+		if (!excluded && (all || std::find(profile.begin(), profile.end(), std::string(name)) != profile.end())) {
+			resources.push_back(IDR_RUNTIME_MODULE_FIRST + i);
+		} else {
+			DEBUG_LOG("Runtime module not in profile: " + std::string(name));
+		}
+	}
+	return resources;
+}
+
+/**
+ * @brief Checks whether a zip entry belongs to the boot set.
+ *
+ * @param patterns The boot set patterns.
+ * @param name The zip entry name.
+ * @return True if the entry is required to start the application.
+ */
+bool isBootEntry(const std::vector<std::string>& patterns, const std::string& name) {
+    bool matched = false;
+    for (const std::string& pattern : patterns) {
+        if (pattern[0] == '!') {
+            if (matchesPattern(pattern.substr(1), name)) {
+                return false;
+            }
+        } else if (!matched && matchesPattern(pattern, name)) {
+            matched = true;
+        }
+    }
+    return matched;
+}
+
+/**
+ * @brief Adds the directories an archive entry needs to a directory plan.
+ *
+ * These are the parent directories of a file entry, or the directory itself
+ * and its parents for a directory entry (ending with a separator). Walking
+ * up stops at the first directory already planned, as its parents are
+ * planned as well.
+ *
+ * @param directories The planned directories, relative to the extraction directory.
+ * @param name The name of the archive entry.
+ */
+void planDirectories(std::unordered_set<std::string>& directories, const std::string& name) {
+	for (size_t pos = name.find_last_of("/\\"); pos != std::string::npos && pos > 0; pos = name.find_last_of("/\\", pos - 1)) {
+		if (!directories.insert(name.substr(0, pos)).second) {
+			return;
+		}
+	}
+}
+
+// Directories to create with their depths (number of separators), by depth
+typedef std::vector<std::pair<size_t, fs::path>> DirectoryLevels;
+
+/**
+ * @brief Creates directories level by level.
+ *
+ * The directories of one level are independent and created by worker
+ * threads if there are many. Directories that already exist are kept.
+ *
+ * @param sorted The directories and their depths, sorted by depth.
+ * @param extractDir The extraction directory, created first.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @throws std::runtime_error if a directory cannot be created.
+ */
+void createDirectoryLevels(const DirectoryLevels& sorted, const std::string& extractDir, unsigned threads) {
+	std::error_code ec;
+	fs::create_directories(extractDir, ec);
+
+	std::atomic<bool> failed(false);
+	std::string failedPath;
+	for (size_t level = 0; level < sorted.size() && !failed; ) {
+		size_t levelEnd = level;
+		while (levelEnd < sorted.size() && sorted[levelEnd].first == sorted[level].first) {
+			++levelEnd;
+		}
+		std::atomic<size_t> next(level);
+		runWorkers(getWorkerCount(threads, (levelEnd - level) / 64), [&](unsigned) {
+			for (size_t i = next++; i < levelEnd && !failed; i = next++) {
+				const fs::path& dirPath = sorted[i].second;
+				if (!CreateDirectoryW(dirPath.c_str(), NULL) && (GetLastError() != ERROR_ALREADY_EXISTS || !fs::is_directory(dirPath, ec))) {
+					if (!failed.exchange(true)) {
+						failedPath = dirPath.string();
+					}
+					return;
+				}
+				DEBUG_LOG("Directory created: " + dirPath.string());
+			}
+		});
+		level = levelEnd;
+	}
+	if (failed) {
+		throw std::runtime_error("Error creating directory: " + failedPath);
+	}
+}
+
+/**
+ * @brief Creates the planned directory tree below the extraction directory.
+ *
+ * The directories are created level by level, parents before children, so
+ * each of them takes a single `CreateDirectoryW` call (see
+ * `createDirectoryLevels`).
+ *
+ * @param directories The planned directories (see `planDirectories`).
+ * @param extractDir The extraction directory.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @throws std::runtime_error if a directory cannot be created.
+ */
+void createDirectoryTree(const std::unordered_set<std::string>& directories, const std::string& extractDir, unsigned threads) {
+	// Sort by depth; the directories of one level are then contiguous
+	DirectoryLevels levels;
+	levels.reserve(directories.size());
+	for (const std::string& dir : directories) {
+		levels.push_back(std::make_pair(static_cast<size_t>(std::count_if(dir.begin(), dir.end(), [](char c) { return c == '/' || c == '\\'; })), fs::path(extractDir) / dir));
+	}
+	std::sort(levels.begin(), levels.end());
+	createDirectoryLevels(levels, extractDir, threads);
+}
+
+/**
+ * @brief Computes the CRC-32 of a file.
+ *
+ * @param path The file.
+ * @param crc Receives the CRC-32.
+ * @return True if the file was read, false otherwise.
+ */
+bool getFileCrc32(const fs::path& path, mz_uint32& crc) {
+	HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	std::vector<mz_uint8> buffer(OVERLAPPED_BUFFER_SIZE);
+	mz_ulong value = MZ_CRC32_INIT;
+	DWORD read = 0;
+	BOOL success = TRUE;
+	while ((success = ReadFile(hFile, buffer.data(), static_cast<DWORD>(buffer.size()), &read, NULL)) && read > 0) {
+		value = mz_crc32(value, buffer.data(), read);
+	}
+	CloseHandle(hFile);
+	crc = static_cast<mz_uint32>(value);
+	return success != FALSE;
+}
+
+/**
+ * @brief Extracts all entries of an opened zip archive to a directory.
+ *
+ * This function walks the central directory of an already initialized
+ * `miniz` reader and writes every entry below the given directory. It is
+ * shared by the file based and the in-memory extraction paths. The
+ * directory tree is planned and created before any file is written, so
+ * archives without directory entries are extracted as well.
+ *
+ * With `TRUSTED_PAYLOAD`, miniz is built without its CRC-32 checks, which
+ * only the embedded payload may skip; the extracted files are therefore
+ * read back and checked against the central directory here.
+ *
+ * @param zip The initialized zip archive reader.
+ * @param zipName Name of the archive, used for log and error messages.
+ * @param extractDir Directory where the zip contents will be extracted.
+ * @throws std::runtime_error if an entry cannot be extracted.
+ */
+void extractZipEntries(mz_zip_archive& zip, const std::string& zipName, const std::string& extractDir) {
+	// Get the number of files in the zip archive
+	int num_files = mz_zip_reader_get_num_files(&zip);
+	if (num_files == 0) {
+		throw std::runtime_error("No files found in the zip archive: " + zipName);
+	}
+
+	std::vector<std::string> names(num_files);
+	std::unordered_set<std::string> directories;
+	for (int i = 0; i < num_files; ++i) {
+		char filename[512];  // Adjust size as needed
+		mz_uint filenameBufSize = sizeof(filename);
+		if (!mz_zip_reader_get_filename(&zip, i, filename, filenameBufSize)) {
+			throw std::runtime_error("Error getting filename from zip: " + zipName);
+		}
+		names[i] = filename;
+		planDirectories(directories, names[i]);
+	}
+	createDirectoryTree(directories, extractDir, 1);
+
+	for (int i = 0; i < num_files; ++i) {
+		const std::string& filenameStr = names[i];
+		if (filenameStr.empty() || filenameStr.back() == '\\' || filenameStr.back() == '/') {
+			continue;  // Directory, already created
+		}
+		fs::path filePath = fs::path(extractDir) / filenameStr;
+		mz_zip_archive_file_stat stat;
+		if (!mz_zip_reader_file_stat(&zip, i, &stat) || !extractEntryToFile(zip, i, stat.m_uncomp_size, filePath)) {
+			throw std::runtime_error("Error extracting file: " + filePath.string());
+		}
+		mz_uint32 crc = 0;
+		if (TRUSTED_PAYLOAD && (!getFileCrc32(filePath, crc) || crc != stat.m_crc32)) {
+			throw std::runtime_error("CRC-32 mismatch of extracted file: " + filePath.string());
+		}
+		DEBUG_LOG("Extracted: " + filePath.string());
+	}
+}
+
+/**
+ * @brief Locates the raw (possibly compressed) data of an entry in archive memory.
+ *
+ * The data of an entry follows its local file header, whose name and extra
+ * field lengths may differ from the ones in the central directory.
+ *
+ * @param archive Pointer to the zip archive in memory.
+ * @param archiveSize Size of the zip archive in bytes.
+ * @param stat The entry's central directory information.
+ * @return Pointer to the `m_comp_size` bytes of entry data, or NULL if the
+ *         entry is encrypted or its local header is invalid.
+ */
+const void* getRawEntryData(const void* archive, size_t archiveSize, const mz_zip_archive_file_stat& stat) {
+	const mz_uint32 localHeaderSignature = 0x04034b50;
+	const size_t localHeaderSize = 30;
+	if ((stat.m_bit_flag & 1) != 0) {
+		return NULL;
+	}
+	const mz_uint8* bytes = static_cast<const mz_uint8*>(archive);
+	if (stat.m_local_header_ofs > archiveSize || archiveSize - stat.m_local_header_ofs < localHeaderSize) {
+		return NULL;
+	}
+	const mz_uint8* header = bytes + stat.m_local_header_ofs;
+	mz_uint32 signature = header[0] | (header[1] << 8) | (header[2] << 16) | ((mz_uint32)header[3] << 24);
+	if (signature != localHeaderSignature) {
+		return NULL;
+	}
+	mz_uint64 dataOffset = stat.m_local_header_ofs + localHeaderSize + (header[26] | (header[27] << 8)) + (header[28] | (header[29] << 8));
+	if (dataOffset > archiveSize || archiveSize - dataOffset < stat.m_comp_size) {
+		return NULL;
+	}
+	return bytes + dataOffset;
+}
+
+/**
+ * @brief Locates the data of a stored (uncompressed) entry in archive memory.
+ *
+ * @param archive Pointer to the zip archive in memory.
+ * @param archiveSize Size of the zip archive in bytes.
+ * @param stat The entry's central directory information.
+ * @return Pointer to the entry data, or NULL if the entry is compressed,
+ *         encrypted or its local header is invalid.
+ */
+const void* getStoredEntryData(const void* archive, size_t archiveSize, const mz_zip_archive_file_stat& stat) {
+	if (stat.m_method != MZ_NO_COMPRESSION || stat.m_comp_size != stat.m_uncomp_size) {
+		return NULL;
+	}
+	return getRawEntryData(archive, archiveSize, stat);
+}
+
+/**
+ * @brief CRC-32 and size of an extracted zip entry.
+ */
+struct ManifestEntry {
+	mz_uint32 crc32;
+	mz_uint64 size;
+};
+
+// Extracted zip entries by name; directory names end with '/'
+typedef std::unordered_map<std::string, ManifestEntry> Manifest;
+
+/**
+ * @brief A payload index (see payload_index.h) checked against its archive.
+ */
+struct PayloadIndex {
+	const PayloadIndexHeader* header = NULL;
+	const PayloadIndexFile* files = NULL;
+	const PayloadIndexDirectory* directories = NULL;
+	const mz_uint16* paths = NULL;
+	const char* names = NULL;
+
+	/** @brief True if the index is valid for the archive. */
+	explicit operator bool() const { return header != NULL; }
+};
+
+/**
+ * @brief Retrieves the payload index of an embedded zip archive.
+ *
+ * The index is resource `IDR_PAYLOAD_INDEX_BASE + resourceID`. All of its
+ * offsets are checked against the index and the archive, so the extraction
+ * can use them without further checks.
+ *
+ * @param resourceID The identifier of the zip resource.
+ * @param archive The view of the zip resource.
+ * @return The index; empty if there is none or it does not match the archive.
+ */
+PayloadIndex getPayloadIndex(UINT resourceID, const ResourceView& archive) {
+	PayloadIndex index;
+	const ResourceView view = getResourceView(IDR_PAYLOAD_INDEX_BASE + resourceID);
+	const PayloadIndexHeader* header = static_cast<const PayloadIndexHeader*>(view.data);
+	if (!view || view.size < sizeof(PayloadIndexHeader) || header->magic != PAYLOAD_INDEX_MAGIC || header->version != PAYLOAD_INDEX_VERSION ||
+		header->headerSize != sizeof(PayloadIndexHeader) || header->archiveSize != archive.size) {
+		DEBUG_LOG("No payload index for resource " + std::to_string(resourceID));
+		return index;
+	}
+	const mz_uint64 filesOffset = sizeof(PayloadIndexHeader);
+	const mz_uint64 directoriesOffset = filesOffset + static_cast<mz_uint64>(header->fileCount) * sizeof(PayloadIndexFile);
+	const mz_uint64 pathsOffset = directoriesOffset + static_cast<mz_uint64>(header->directoryCount) * sizeof(PayloadIndexDirectory);
+	const mz_uint64 namesOffset = pathsOffset + static_cast<mz_uint64>(header->pathsLength) * sizeof(mz_uint16);
+	if (namesOffset + header->namesLength > view.size) {
+		printErrorInfo("Payload index of resource " + std::to_string(resourceID) + " is truncated");
+		return index;
+	}
+	const PayloadIndexFile* files = reinterpret_cast<const PayloadIndexFile*>(view.bytes() + filesOffset);
+	const PayloadIndexDirectory* directories = reinterpret_cast<const PayloadIndexDirectory*>(view.bytes() + directoriesOffset);
+	for (mz_uint32 i = 0; i < header->fileCount; i++) {
+		const PayloadIndexFile& file = files[i];
+		if (static_cast<mz_uint64>(file.pathOffset) + file.pathLength > header->pathsLength || file.pathLength == 0 ||
+			static_cast<mz_uint64>(file.nameOffset) + file.nameLength > header->namesLength ||
+			static_cast<mz_uint64>(file.dataOffset) + file.compressedSize > archive.size) {
+			printErrorInfo("Payload index of resource " + std::to_string(resourceID) + " is invalid");
+			return index;
+		}
+	}
+	for (mz_uint32 i = 0; i < header->directoryCount; i++) {
+		if (static_cast<mz_uint64>(directories[i].pathOffset) + directories[i].pathLength > header->pathsLength || directories[i].pathLength == 0) {
+			printErrorInfo("Payload index of resource " + std::to_string(resourceID) + " is invalid");
+			return index;
+		}
+	}
+	index.header = header;
+	index.files = files;
+	index.directories = directories;
+	index.paths = reinterpret_cast<const mz_uint16*>(view.bytes() + pathsOffset);
+	index.names = reinterpret_cast<const char*>(view.bytes() + namesOffset);
+	return index;
+}
+
+/**
+ * @brief Extracts all entries of an in-memory zip archive using worker threads.
+ *
+ * The directory tree, including the parents of file entries without a
+ * directory entry, is planned from the central directory and created
+ * first (see `createDirectoryTree`), so the workers only write files. The
+ * file entries are then sorted by
+ * uncompressed size, largest first, and claimed one by one by the workers,
+ * which keeps the amount of inflated bytes balanced between the threads.
+ * Each worker opens its own `miniz` reader over the same memory, as a
+ * `mz_zip_archive` must not be shared between threads.
+ *
+ * Entries stored without compression (`MZ_NO_COMPRESSION`) bypass `miniz`
+ * and are written directly from the archive memory. With
+ * `HARDLINK_DUPLICATES`, of all files with the same CRC-32 and size (and,
+ * with `HARDLINK_VERIFY`, the same compressed data) only the first is
+ * written; the others are hard links to it, created once it is complete.
+ *
+ * With `ExtractionPass::Boot` only the directories and the boot set entries
+ * are written; `ExtractionPass::Deferred` writes the remaining files. Files
+ * listed in `unchanged` with the same CRC-32 and size are already in place
+ * (delta extraction) and are skipped.
+ *
+ * With a payload `index`, the files, the directory tree and the boot set
+ * are taken from it instead: its records are already sorted, and only the
+ * extraction directory is prepended to their paths.
+ *
+ * @param data Pointer to the zip archive in memory.
+ * @param size Size of the zip archive in bytes.
+ * @param zipName Name of the archive, used for log and error messages.
+ * @param extractDir Directory where the zip contents will be extracted.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @param pass The entries to extract.
+ * @param unchanged Files already extracted to `extractDir`, or NULL.
+ * @param index The payload index of the archive (see `getPayloadIndex`), or NULL.
+ * @throws std::runtime_error if an entry cannot be extracted.
+ */
+void extractZipEntriesParallel(const void* data, size_t size, const std::string& zipName, const std::string& extractDir, unsigned threads, ExtractionPass pass, const Manifest* unchanged = NULL, const PayloadIndex* index = NULL) {
+	struct FileEntry {
+		mz_uint index;
+		mz_uint64 size;
+		fs::path path;
+		const void* storedData;  // Entry data in the archive memory if stored uncompressed
+		mz_uint32 crc32;
+		const void* rawData;     // Raw entry data in the archive memory, to confirm duplicates
+		mz_uint64 rawSize;
+		fs::path linkTarget;     // First copy of a duplicate file
+	};
+	std::vector<FileEntry> files;
+	LONGLONG start = getTimestamp();
+	size_t skipped = 0;
+
+	if (index != NULL && *index) {
+		const mz_uint8* bytes = static_cast<const mz_uint8*>(data);
+		const std::wstring base = fs::path(extractDir).wstring() + L'\\';
+		auto makePath = [&](mz_uint32 offset, mz_uint16 length) {
+			std::wstring path;
+			path.reserve(base.size() + length);
+			path.append(base).append(index->paths + offset, index->paths + offset + length);
+			return fs::path(std::move(path));
+		};
+		DirectoryLevels levels;
+		if (pass != ExtractionPass::Deferred) {
+			levels.reserve(index->header->directoryCount);
+			for (mz_uint32 i = 0; i < index->header->directoryCount; i++) {
+				const PayloadIndexDirectory& dir = index->directories[i];
+				levels.push_back(std::make_pair(static_cast<size_t>(dir.depth), makePath(dir.pathOffset, dir.pathLength)));
+			}
+		}
+		files.reserve(index->header->fileCount);
+		for (mz_uint32 i = 0; i < index->header->fileCount; i++) {
+			const PayloadIndexFile& file = index->files[i];
+			if (pass != ExtractionPass::All && (file.priority == PAYLOAD_PRIORITY_BOOT) != (pass == ExtractionPass::Boot)) {
+				continue;
+			}
+			if (unchanged != NULL) {
+				auto existing = unchanged->find(std::string(index->names + file.nameOffset, file.nameLength));
+				if (existing != unchanged->end() && existing->second.crc32 == file.crc32 && existing->second.size == file.size) {
+					++skipped;
+					continue;
+				}
+			}
+			const void* rawData = bytes + file.dataOffset;
+			const bool stored = file.method == MZ_NO_COMPRESSION && file.compressedSize == file.size;
+			files.push_back({ file.zipIndex, file.size, makePath(file.pathOffset, file.pathLength), stored ? rawData : NULL, file.crc32, rawData, file.compressedSize, fs::path() });
+		}
+		createDirectoryLevels(levels, extractDir, threads);
+		recordTiming("directories", zipName, start, 0, levels.size());
+	} else {
+		const std::vector<std::string> bootSet = (pass == ExtractionPass::All) ? std::vector<std::string>() : getBootSet();
+		std::unordered_set<std::string> directories;
+		mz_zip_archive zip;
+		memset(&zip, 0, sizeof(zip));
+		if (!mz_zip_reader_init_mem(&zip, data, size, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)) {
+			throw std::runtime_error("Error opening zip archive: " + zipName);
+		}
+		try {
+			mz_uint num_files = mz_zip_reader_get_num_files(&zip);
+			if (num_files == 0) {
+				throw std::runtime_error("No files found in the zip archive: " + zipName);
+			}
+			for (mz_uint i = 0; i < num_files; ++i) {
+				mz_zip_archive_file_stat stat;
+				if (!mz_zip_reader_file_stat(&zip, i, &stat)) {
+					throw std::runtime_error("Error getting file information from zip: " + zipName);
+				}
+				if (pass != ExtractionPass::Deferred) {
+					planDirectories(directories, stat.m_filename);  // The boot pass creates the whole tree
+				}
+				if (!stat.m_is_directory && (pass == ExtractionPass::All || isBootEntry(bootSet, stat.m_filename) == (pass == ExtractionPass::Boot))) {
+					if (unchanged != NULL) {
+						auto existing = unchanged->find(stat.m_filename);
+						if (existing != unchanged->end() && existing->second.crc32 == stat.m_crc32 && existing->second.size == stat.m_uncomp_size) {
+							++skipped;
+							continue;
+						}
+					}
+					files.push_back({ i, stat.m_uncomp_size, fs::path(extractDir) / stat.m_filename, getStoredEntryData(data, size, stat), stat.m_crc32, getRawEntryData(data, size, stat), stat.m_comp_size, fs::path() });
+				}
+			}
+		} catch (...) {
+			mz_zip_reader_end(&zip);
+			throw;
+		}
+		mz_zip_reader_end(&zip);
+		createDirectoryTree(directories, extractDir, threads);
+		recordTiming("directories", zipName, start, 0, directories.size());
+	}
+	if (skipped > 0) {
+		DEBUG_LOG("Unchanged files kept: " + std::to_string(skipped) + " in " + zipName);
+	}
+
+	// Duplicates are linked to the first copy once all files are written
+	std::vector<FileEntry> duplicates;
+	if (HARDLINK_DUPLICATES) {
+		std::vector<FileEntry> unique;
+		std::unordered_map<mz_uint64, std::vector<size_t>> bySize;
+		for (FileEntry& file : files) {
+			std::vector<size_t>* candidates = (file.size >= HARDLINK_MIN_SIZE) ? &bySize[file.size] : NULL;
+			if (candidates != NULL) {
+				for (size_t candidate : *candidates) {
+					const FileEntry& first = unique[candidate];
+					if (first.crc32 == file.crc32 && (!HARDLINK_VERIFY || (first.rawData != NULL && file.rawData != NULL &&
+							first.rawSize == file.rawSize && memcmp(first.rawData, file.rawData, static_cast<size_t>(file.rawSize)) == 0))) {
+						file.linkTarget = first.path;
+						break;
+					}
+				}
+			}
+			if (!file.linkTarget.empty()) {
+				duplicates.push_back(file);
+			} else {
+				if (candidates != NULL) {
+					candidates->push_back(unique.size());
+				}
+				unique.push_back(file);
+			}
+		}
+		files.swap(unique);
+	}
+
+	if (index == NULL || !*index) {
+		std::sort(files.begin(), files.end(), [](const FileEntry& a, const FileEntry& b) { return a.size > b.size; });
+	}
+	start = getTimestamp();
+	mz_uint64 totalBytes = 0;
+	for (const FileEntry& file : files) {
+		totalBytes += file.size;
+	}
+
+	std::atomic<size_t> nextFile(0);
+	std::atomic<bool> failed(false);
+	std::string error;
+	CRITICAL_SECTION errorLock;
+	InitializeCriticalSection(&errorLock);
+
+	auto fail = [&](const std::string& message) {
+		EnterCriticalSection(&errorLock);
+		if (!failed.exchange(true)) {
+			error = message;
+		}
+		LeaveCriticalSection(&errorLock);
+	};
+
+	auto extractFile = [&](mz_zip_archive& workerZip, const FileEntry& file) {
+		if (file.storedData != NULL) {
+			// Stored entries need no inflating: write them straight from the archive memory
+			if ((!TRUSTED_PAYLOAD && mz_crc32(MZ_CRC32_INIT, static_cast<const mz_uint8*>(file.storedData), static_cast<size_t>(file.size)) != file.crc32) ||
+				!writeFileData(file.path, file.storedData, file.size)) {
+				fail("Error extracting stored file: " + file.path.string());
+				return false;
+			}
+		} else if (!extractEntryToFile(workerZip, file.index, file.size, file.path)) {
+			fail("Error extracting file: " + file.path.string());
+			return false;
+		}
+		DEBUG_LOG("Extracted: " + file.path.string());
+		return true;
+	};
+
+	std::atomic<size_t> linkedFiles(0);
+	std::atomic<mz_uint64> linkedBytes(0);
+	FileCost cost;
+	auto extractFiles = [&](const std::vector<FileEntry>& entries, bool linking) {
+		nextFile = 0;
+		runWorkers(getWorkerCount(threads, linking ? entries.size() / 64 : entries.size()), [&](unsigned) {
+			currentFileCost = &cost;
+			ZipArena arena;
+			mz_zip_archive workerZip;
+			memset(&workerZip, 0, sizeof(workerZip));
+			attachZipArena(workerZip, arena);
+			if (!mz_zip_reader_init_mem(&workerZip, data, size, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)) {
+				fail("Error opening zip archive: " + zipName);
+				currentFileCost = NULL;
+				return;
+			}
+			for (size_t i = nextFile++; i < entries.size() && !failed; i = nextFile++) {
+				const FileEntry& file = entries[i];
+				if (linking && CreateHardLinkW(file.path.c_str(), file.linkTarget.c_str(), NULL)) {
+					++linkedFiles;
+					linkedBytes += file.size;
+					DEBUG_LOG("Linked: " + file.path.string() + " -> " + file.linkTarget.string());
+					continue;
+				}
+				// Not linkable (file system without hard links, link limit reached): write a copy
+				if (!extractFile(workerZip, file)) {
+					break;
+				}
+			}
+			mz_zip_reader_end(&workerZip);
+			currentFileCost = NULL;
+		});
+	};
+
+	// The first copies are written first, then the duplicates are linked to them
+	extractFiles(files, false);
+	if (!failed) {
+		recordTiming("inflate", zipName, start, totalBytes, files.size());
+	}
+	if (!failed && !duplicates.empty()) {
+		start = getTimestamp();
+		extractFiles(duplicates, true);
+		recordTiming("hardlink", zipName, start, linkedBytes, linkedFiles);
+	}
+	if (!failed) {
+		recordFileCost(zipName, cost);
+	}
+
+	DeleteCriticalSection(&errorLock);
+	if (failed) {
+		throw std::runtime_error(error);
+	}
+}
+
+/**
+ * @brief An entry of a tar archive held in memory.
+ */
+struct TarEntry {
+	std::string name;     // Entry name, directories end with '/'
+	const char* data;     // Entry data within the archive
+	mz_uint64 size;
+	bool isDirectory;
+};
+
+/**
+ * @brief Parses a numeric field of a tar header.
+ *
+ * Fields are octal numbers, or big-endian base-256 numbers if the high bit of
+ * the first byte is set (GNU extension for sizes of 8 GB and more).
+ *
+ * @param field Pointer to the field.
+ * @param length Length of the field in bytes.
+ * @return The value of the field.
+ */
+mz_uint64 parseTarNumber(const char* field, size_t length) {
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(field);
+	mz_uint64 value = 0;
+	if ((p[0] & 0x80) != 0) {
+		value = p[0] & 0x7F;
+		for (size_t i = 1; i < length; ++i) {
+			value = (value << 8) | p[i];
+		}
+		return value;
+	}
+	for (size_t i = 0; i < length && (p[i] == ' ' || (p[i] >= '0' && p[i] <= '7')); ++i) {
+		if (p[i] != ' ') {
+			value = (value << 3) | (p[i] - '0');
+		}
+	}
+	return value;
+}
+
+/**
+ * @brief Lists the regular files and directories of a tar archive in memory.
+ *
+ * Supports ustar archives including the GNU long name ('L') and pax ('x')
+ * extensions for names longer than 100 characters. Other entry types, such
+ * as links, are rejected.
+ *
+ * @param data Pointer to the tar archive.
+ * @param size Size of the tar archive in bytes.
+ * @param archiveName Name of the archive, used for error messages.
+ * @return The entries in archive order.
+ * @throws std::runtime_error if the archive is malformed or unsupported.
+ */
+std::vector<TarEntry> parseTarEntries(const char* data, size_t size, const std::string& archiveName) {
+	const size_t blockSize = 512;
+	std::vector<TarEntry> entries;
+	std::string longName;
+	size_t pos = 0;
+
+	while (size - pos >= blockSize) {
+		const char* header = data + pos;
+		if (std::all_of(header, header + blockSize, [](char c) { return c == 0; })) {
+			break;  // End of archive
+		}
+		if (memcmp(header + 257, "ustar", 5) != 0) {
+			throw std::runtime_error("Unsupported tar format: " + archiveName);
+		}
+		mz_uint64 entrySize = parseTarNumber(header + 124, 12);
+		char type = header[156];
+		pos += blockSize;
+		if (entrySize > size - pos) {
+			throw std::runtime_error("Truncated tar archive: " + archiveName);
+		}
+		const char* body = data + pos;
+		pos += static_cast<size_t>(std::min<mz_uint64>((entrySize + blockSize - 1) / blockSize * blockSize, size - pos));
+
+		std::string name;
+		if (!longName.empty()) {
+			name.swap(longName);
+		} else {
+			name.assign(header, strnlen(header, 100));
+			if (memcmp(header + 257, "ustar\0", 6) == 0 && header[345] != 0) {
+				name = std::string(header + 345, strnlen(header + 345, 155)) + "/" + name;  // POSIX prefix field
+			}
+		}
+
+		if (type == 'L') {
+			// GNU long name of the next entry
+			longName.assign(body, strnlen(body, static_cast<size_t>(entrySize)));
+			continue;
+		}
+		if (type == 'x') {
+			// pax extended header, records are "<length> <key>=<value>\n"
+			const char* record = body;
+			const char* end = body + entrySize;
+			while (record < end) {
+				size_t length = 0;
+				const char* p = record;
+				while (p < end && *p >= '0' && *p <= '9') {
+					length = length * 10 + (*p++ - '0');
+				}
+				if (length == 0 || length > static_cast<size_t>(end - record)) {
+					throw std::runtime_error("Invalid pax header in tar archive: " + archiveName);
+				}
+				std::string field(p, record + length - 1);
+				if (field.compare(0, 6, " path=") == 0) {
+					longName = field.substr(6);
+				}
+				record += length;
+			}
+			continue;
+		}
+		if (type == 'g') {
+			continue;  // Global pax header, nothing relevant
+		}
+		bool isDirectory = (type == '5');
+		if (!isDirectory && type != '0' && type != '\0' && type != '7') {
+			throw std::runtime_error("Unsupported entry type '" + std::string(1, type) + "' in tar archive: " + archiveName);
+		}
+
+		while (name.compare(0, 2, "./") == 0) {
+			name.erase(0, 2);
+		}
+		if (name.empty() || name == ".") {
+			continue;
+		}
+		if (isDirectory && name.back() != '/') {
+			name += '/';
+		}
+		entries.push_back({ name, body, entrySize, isDirectory });
+	}
+	return entries;
+}
+
+/**
+ * @brief Decodes an LZ4 frame into a newly allocated buffer using worker threads.
+ *
+ * The frame must store its content size. Frames with independent blocks,
+ * the `lz4` default, are decoded in parallel: every block but the last one
+ * decodes to exactly the maximum block size, so the output offset of each
+ * block is known in advance. Linked blocks are decoded sequentially.
+ *
+ * @param data Pointer to the LZ4 frame.
+ * @param size Size of the LZ4 frame in bytes.
+ * @param archiveName Name of the archive, used for error messages.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @param contentSize Receives the decoded size.
+ * @return The decoded content, to be released with `VirtualFree`.
+ * @throws std::runtime_error if the frame cannot be decoded.
+ */
+char* decodeLz4Frame(const void* data, size_t size, const std::string& archiveName, unsigned threads, size_t& contentSize) {
+	lz4_frame_info info;
+	if (!lz4_frame_parse_header(data, size, &info)) {
+		throw std::runtime_error("Invalid or unsupported LZ4 frame: " + archiveName);
+	}
+	if (!info.has_content_size || info.content_size > SIZE_MAX - 1) {
+		throw std::runtime_error("LZ4 frame without content size: " + archiveName);
+	}
+	contentSize = static_cast<size_t>(info.content_size);
+
+	std::vector<lz4_frame_block> blocks;
+	size_t pos = info.header_size;
+	lz4_frame_block block;
+	int result;
+	while ((result = lz4_frame_next_block(data, size, &info, &pos, &block)) == 1) {
+		blocks.push_back(block);
+	}
+	if (result < 0 || (contentSize + info.block_max_size - 1) / info.block_max_size != blocks.size()) {
+		throw std::runtime_error("Corrupt LZ4 frame: " + archiveName);
+	}
+
+	// Pages are only committed as they are written
+	char* content = static_cast<char*>(VirtualAlloc(NULL, std::max<size_t>(contentSize, 1), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+	if (content == NULL) {
+		throw std::runtime_error("Failed to allocate memory for " + archiveName + ". Error Code: " + std::to_string(GetLastError()));
+	}
+
+	std::atomic<size_t> nextBlock(0);
+	std::atomic<bool> failed(false);
+	auto decodeBlocks = [&](unsigned) {
+		for (size_t i = nextBlock++; i < blocks.size() && !failed; i = nextBlock++) {
+			size_t offset = i * info.block_max_size;
+			size_t capacity = std::min(info.block_max_size, contentSize - offset);
+			const char* dictStart = info.independent_blocks ? content + offset : content;
+			if (lz4_frame_decode_block(&info, &blocks[i], content + offset, capacity, dictStart) != static_cast<ptrdiff_t>(capacity)) {
+				failed = true;
+			}
+		}
+	};
+	if (info.independent_blocks) {
+		runWorkers(getWorkerCount(threads, blocks.size()), decodeBlocks);
+	} else {
+		decodeBlocks(0);
+	}
+
+	// A trusted payload is verified as a whole before it is decoded
+	if (failed || (!TRUSTED_PAYLOAD && !lz4_frame_verify_content(data, size, &info, pos, content, contentSize))) {
+		VirtualFree(content, 0, MEM_RELEASE);
+		throw std::runtime_error("Corrupt LZ4 frame: " + archiveName);
+	}
+	return content;
+}
+
+/**
+ * @brief Extracts an LZ4 compressed tar archive in memory using worker threads.
+ *
+ * This is the alternative payload format produced by `make.sh` with
+ * `PAYLOAD_FORMAT=lz4`. The frame is decoded into memory first, block by
+ * block on all workers, then the files are written from the decoded tar
+ * archive like stored zip entries. This needs memory for the whole
+ * uncompressed archive, but LZ4 decodes several times faster than inflate.
+ *
+ * Each pass decodes the frame again; `ExtractionPass` is applied as in
+ * `extractZipEntriesParallel`.
+ *
+ * @param data Pointer to the LZ4 frame.
+ * @param size Size of the LZ4 frame in bytes.
+ * @param archiveName Name of the archive, used for log and error messages.
+ * @param extractDir Directory where the archive contents will be extracted.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @param pass The entries to extract.
+ * @throws std::runtime_error if an entry cannot be extracted.
+ */
+void extractTarLz4Parallel(const void* data, size_t size, const std::string& archiveName, const std::string& extractDir, unsigned threads, ExtractionPass pass) {
+	size_t contentSize = 0;
+	LONGLONG start = getTimestamp();
+	char* content = decodeLz4Frame(data, size, archiveName, threads, contentSize);
+	recordTiming("decode", archiveName, start, contentSize);
+
+	std::string error;
+	try {
+		std::vector<TarEntry> entries = parseTarEntries(content, contentSize, archiveName);
+		const std::vector<std::string> bootSet = (pass == ExtractionPass::All) ? std::vector<std::string>() : getBootSet();
+		std::vector<const TarEntry*> files;
+		std::unordered_set<std::string> directories;
+		start = getTimestamp();
+		for (const TarEntry& entry : entries) {
+			if (pass != ExtractionPass::Deferred) {
+				planDirectories(directories, entry.name);  // The boot pass creates the whole tree
+			}
+			if (!entry.isDirectory && (pass == ExtractionPass::All || isBootEntry(bootSet, entry.name) == (pass == ExtractionPass::Boot))) {
+				files.push_back(&entry);
+			}
+		}
+		createDirectoryTree(directories, extractDir, threads);
+		recordTiming("directories", archiveName, start, 0, directories.size());
+		std::sort(files.begin(), files.end(), [](const TarEntry* a, const TarEntry* b) { return a->size > b->size; });
+		start = getTimestamp();
+		mz_uint64 totalBytes = 0;
+		for (const TarEntry* file : files) {
+			totalBytes += file->size;
+		}
+
+		std::atomic<size_t> nextFile(0);
+		std::atomic<bool> failed(false);
+		CRITICAL_SECTION errorLock;
+		InitializeCriticalSection(&errorLock);
+		FileCost cost;
+		runWorkers(getWorkerCount(threads, files.size()), [&](unsigned) {
+			currentFileCost = &cost;
+			for (size_t i = nextFile++; i < files.size() && !failed; i = nextFile++) {
+				fs::path filePath = fs::path(extractDir) / files[i]->name;
+				if (!writeFileData(filePath, files[i]->data, files[i]->size)) {
+					EnterCriticalSection(&errorLock);
+					if (!failed.exchange(true)) {
+						error = "Error extracting file: " + filePath.string();
+					}
+					LeaveCriticalSection(&errorLock);
+					break;
+				}
+				DEBUG_LOG("Extracted: " + filePath.string());
+			}
+			currentFileCost = NULL;
+		});
+		DeleteCriticalSection(&errorLock);
+		if (error.empty()) {
+			recordTiming("write", archiveName, start, totalBytes, files.size());
+			recordFileCost(archiveName, cost);
+		}
+	} catch (...) {
+		VirtualFree(content, 0, MEM_RELEASE);
+		throw;
+	}
+	VirtualFree(content, 0, MEM_RELEASE);
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+}
+
+/**
+ * @brief Extracts the contents of a zip file to a specified directory.
+ *
+ * This function unzips a zip archive and extracts its contents to a given
+ * directory using the `miniz` library. It also cleans up the zip file after extraction.
+ *
+ * @param zipPath Path to the zip file to be extracted.
+ * @param extractDir Directory where the zip contents will be extracted.
+ */
+void unzipFile(const std::string& zipPath, const std::string& extractDir) {
+    ZipArena arena;
+    mz_zip_archive zip;
+    memset(&zip, 0, sizeof(zip));
+    attachZipArena(zip, arena);
+    try {
+		// Open the zip file
+		if (!mz_zip_reader_init_file(&zip, zipPath.c_str(), 0)) {
+			throw std::runtime_error("Error opening zip file: " + zipPath);
+		}
+
+		extractZipEntries(zip, zipPath, extractDir);
+
+		mz_zip_reader_end(&zip);
+		DEBUG_LOG("Unzip operation completed for: " + zipPath);
+		// Remove the zip file after extraction
+		if (fs::exists(zipPath)) {
+			fs::remove(zipPath);
+			DEBUG_LOG("Zip file removed: " + zipPath);
+		}
+    } catch (const fs::filesystem_error& e) {
+    	mz_zip_reader_end(&zip);
+        printErrorInfo("File system error: " + std::string(e.what()));
+    } catch (const std::exception& e) {
+    	mz_zip_reader_end(&zip);
+        printErrorInfo("Error during unzip operation: " + std::string(e.what()));
+    }
+}
+
+/**
+ * @brief Verifies a resource against the CRC-32 computed at build time.
+ *
+ * Used with `TRUSTED_PAYLOAD`: make.sh stores the CRC-32 of each embedded
+ * archive as string `IDS_RESOURCE_CHECKSUM_BASE + resourceID`. A single pass
+ * over the compressed resource replaces the checks of all extracted entries.
+ *
+ * @param resourceID The identifier of the resource.
+ * @param resource The resource data.
+ * @return True if the resource matches its checksum, false otherwise.
+ */
+bool verifyResourceChecksum(UINT resourceID, const ResourceView& resource) {
+	char expected[16];
+	if (!LoadStringA(GetModuleHandle(NULL), IDS_RESOURCE_CHECKSUM_BASE + resourceID, expected, sizeof(expected))) {
+		printErrorInfo("No build-time checksum for resource " + std::to_string(resourceID));
+		return false;
+	}
+	LONGLONG start = getTimestamp();
+	char actual[9];
+	snprintf(actual, sizeof(actual), "%08lx", static_cast<unsigned long>(mz_crc32(MZ_CRC32_INIT, resource.bytes(), resource.size)));
+	recordTiming("verify", "resource " + std::to_string(resourceID), start, resource.size);
+	DEBUG_LOG("Resource " + std::to_string(resourceID) + " CRC-32 (" + crc32_implementation() + "): " + actual);
+	if (strcmp(actual, expected) != 0) {
+		printErrorInfo("Resource " + std::to_string(resourceID) + " is corrupt: CRC-32 " + actual + ", expected " + expected);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Extracts a zip archive embedded as a resource to a specified directory.
+ *
+ * This function opens the zip archive directly on the locked resource memory
+ * with `mz_zip_reader_init_mem`. Unlike `extractResource` followed by
+ * `unzipFile`, nothing is copied and no temporary zip file is written to disk.
+ * The entries are inflated by a pool of worker threads.
+ *
+ * Resources starting with the LZ4 frame magic number hold an LZ4 compressed
+ * tar archive instead and are extracted by `extractTarLz4Parallel`. With
+ * `TRUSTED_PAYLOAD`, the resource is verified once before (see
+ * `verifyResourceChecksum`) instead of entry by entry.
+ *
+ * @param resourceID The identifier of the zip resource to extract.
+ * @param extractDir Directory where the zip contents will be extracted.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @param pass The entries to extract.
+ * @param unchanged Zip entries already extracted to `extractDir`, or NULL.
+ * @return True if all entries were extracted, false otherwise.
+ */
+bool unzipResource(UINT resourceID, const std::string& extractDir, unsigned threads = EXTRACTION_THREADS, ExtractionPass pass = ExtractionPass::All, const Manifest* unchanged = NULL) {
+    const std::string zipName = "resource " + std::to_string(resourceID);
+    try {
+		const ResourceView resource = getResourceView(resourceID);
+		if (!resource) {
+			throw std::runtime_error("Failed to access " + zipName);
+		}
+		// The deferred pass follows the boot pass, which verified the resource already
+		if (TRUSTED_PAYLOAD && pass != ExtractionPass::Deferred && !verifyResourceChecksum(resourceID, resource)) {
+			throw std::runtime_error("Checksum mismatch: " + zipName);
+		}
+
+		// Extract straight from the resource memory, the format is chosen by its magic number
+		const mz_uint8* bytes = resource.bytes();
+		if (resource.size >= 4 && (bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((mz_uint32)bytes[3] << 24)) == LZ4_FRAME_MAGIC) {
+			extractTarLz4Parallel(resource.data, resource.size, zipName, extractDir, threads, pass);
+		} else {
+			const PayloadIndex index = PAYLOAD_INDEX ? getPayloadIndex(resourceID, resource) : PayloadIndex();
+			extractZipEntriesParallel(resource.data, resource.size, zipName, extractDir, threads, pass, unchanged, &index);
+		}
+
+		DEBUG_LOG("Unzip operation completed for: " + zipName);
+		return true;
+    } catch (const fs::filesystem_error& e) {
+        printErrorInfo("File system error: " + std::string(e.what()));
+    } catch (const std::exception& e) {
+        printErrorInfo("Error during unzip operation: " + std::string(e.what()));
+    }
+    return false;
+}
+
+/**
+ * @brief Retrieves the executable name from resources.
+ *
+ * This function uses Windows resource management to load a string resource
+ * that contains the name of the executable to be launched. The resource ID
+ * (IDS_EXECUTABLE) must be defined in the application resources.
+ *
+ * @return The name of the executable as a string.
+ */
+std::string getExecutable() {
+    // Get the current module handle
+    HMODULE hModule = GetModuleHandle(NULL);
+    char buffer[MAX_PATH];
+    // Load the resource string
+    if (!LoadStringA(hModule, IDS_EXECUTABLE, buffer, MAX_PATH)) {
+        printErrorInfo("Failed to load executable name resource!");
+    }
+    return std::string(buffer);
+}
+
+/**
+ * @brief Retrieves the system's temporary directory.
+ *
+ * This function uses the Windows API (GetTempPath) to retrieve the path of
+ * the system's temporary directory. It handles errors by throwing a runtime
+ * exception if the temporary directory cannot be retrieved.
+ *
+ * @return The temporary directory path as a string.
+ * @throws std::runtime_error if the temporary directory cannot be retrieved.
+ */
+std::string getTempDirectory() {
+    // Use the OS temporary directory on Windows
+    char tempPath[MAX_PATH];
+    if (GetTempPath(MAX_PATH, tempPath)) {
+        return std::string(tempPath);
+    } else {
+    	printErrorInfo("Failed to get temporary directory.");
+        throw std::runtime_error("Failed to get temporary directory.");
+    }
+}
+
+/**
+ * @brief Sanitizes a directory or file name by replacing invalid characters.
+ *
+ * This function sanitizes a string by replacing any character that is not
+ * alphanumeric, hyphen, or underscore with an underscore ('_'). This is useful
+ * for creating valid filenames or directory names on the filesystem.
+ *
+ * @param name The original name to be sanitized.
+ * @return A sanitized version of the input name.
+ */
+std::string sanitizeFileName(const std::string& name) {
+	std::string sanitizedName = name;
+	// Replace unsafe characters with underscores
+	for (char& ch : sanitizedName) {
+		if (unsafeChars.find(ch) != std::string::npos) {
+			ch = '_';  // Replace unsafe characters with '_'
+		}
+	}
+    // Trim any leading or trailing whitespace
+    sanitizedName.erase(0, sanitizedName.find_first_not_of(" \t\n\r\f\v"));
+    sanitizedName.erase(sanitizedName.find_last_not_of(" \t\n\r\f\v") + 1);
+    // Ensure the name is not empty after sanitization
+    if (sanitizedName.empty()) {
+        sanitizedName = "default_name";  // Provide a default name if empty
+    }
+    return sanitizedName;
+}
+
+/**
+ * @brief Retrieves the parent directory for run and cache directories.
+ *
+ * If the string resource `IDS_EXTRACTION_ROOT` is set, it returns that
+ * directory, with environment variables expanded and created if needed; it
+ * is meant for a location excluded from on-access scanning by policy.
+ * Otherwise, if the `USE_TEMP_DIRECTORY` flag is set, it returns the system's
+ * temporary directory. Otherwise, or if the temporary directory cannot be
+ * acquired, it returns the directory containing the executable file.
+ *
+ * @param exePath The full path of the executable file.
+ * @return The parent directory path.
+ */
+fs::path getRunParentDirectory(const fs::path& exePath) {
+    // Determine the parent directory
+    fs::path parentPath;
+    try {
+		char root[MAX_PATH];
+		char expanded[MAX_PATH];
+		DWORD length = 0;
+		if (LoadStringA(GetModuleHandle(NULL), IDS_EXTRACTION_ROOT, root, sizeof(root)) > 0) {
+			length = ExpandEnvironmentStringsA(root, expanded, sizeof(expanded));
+		}
+		if (length > 0 && length <= sizeof(expanded)) {
+			// The configured root, e.g. a directory excluded from scanning
+			std::error_code ec;
+			fs::create_directories(expanded, ec);
+			if (fs::is_directory(expanded, ec)) {
+				return fs::path(expanded);
+			}
+			printErrorInfo("Extraction root not available, using the default location: " + std::string(expanded));
+		}
+		if (USE_TEMP_DIRECTORY) {
+			// Use the system temp directory
+			parentPath = getTempDirectory();
+			// Fallback if temp directory acquisition fails
+			if (parentPath.empty()) {
+				printErrorInfo("Temp directory acquisition failed, falling back to executable directory.");
+				// Parent directory of the executable
+				parentPath = exePath.parent_path();
+			}
+		} else {
+			// Fallback to the current location of the executable
+			parentPath = exePath.parent_path();
+		}
+    } catch (const std::exception& e) {
+    	printErrorInfo("Exception caught while acquiring temp directory: " + std::string(e.what()));
+        // Fall back to the executable directory if temp directory acquisition fails
+		parentPath = exePath.parent_path();
+    }
+    return parentPath;
+}
+
+/**
+ * @brief Retrieves the run directory path for extraction or execution.
+ *
+ * This function calculates the directory where the executable's resources
+ * will be extracted. If the `USE_TEMP_DIRECTORY` flag is set, it returns
+ * a temporary directory. Otherwise, it returns the directory containing
+ * the executable file (minus the file extension), ensuring that any invalid
+ * characters in the path are sanitized.
+ *
+ * @param exeFile The full path of the executable file.
+ * @return The full path of the directory where the executable's resources
+ *         will be extracted or executed from.
+ */
+std::string getRunDirectory(const std::string& exeFile) {
+
+	// Use fs::path for better path handling
+	fs::path exePath(exeFile);
+
+	// Remove the extension and get the base name
+	fs::path baseName = exePath.stem();  // 'stem' removes the file extension
+	std::string sanitizedBaseName = sanitizeFileName(baseName.string());
+	DEBUG_LOG("Sanitized directory: " + sanitizedBaseName);
+
+    // Combine the parent path with the sanitized directory name
+    fs::path runDir = getRunParentDirectory(exePath) / sanitizedBaseName;  // Safer and platform-independent path construction
+
+    // Create the directory if it doesn't exist (for disk extraction)
+    if (!fs::exists(runDir)) {
+        try {
+            if (!fs::create_directory(runDir)) {
+                throw std::runtime_error("Failed to create directory: " + runDir.string());
+            }
+        } catch (const std::exception& e) {
+        	printErrorInfo("Exception during directory creation: " + std::string(e.what()) + " Path: " + runDir.string());
+			throw std::runtime_error("Failed to create directory: " + runDir.string());
+		}
+        DEBUG_LOG("Run directory created: " + runDir.string());
+    }
+
+    return runDir.string();
+}
+
+/**
+ * @brief Computes a fingerprint of a resource's content.
+ *
+ * For zip archives only the central directory is hashed: it holds the CRC32,
+ * sizes and names of all entries, so it identifies the content without having
+ * to read the whole (possibly very large) payload. For LZ4 payloads the frame
+ * header and the content checksum (XXH32) at the end of the frame are used.
+ * Other resources, and zip archives whose central directory cannot be
+ * located, are hashed completely.
+ *
+ * @param resource The resource data.
+ * @param update Adds bytes to the hash.
+ */
+void hashResourceData(const ResourceView& resource, const std::function<void(const void*, size_t)>& update) {
+	const void* data = resource.data;
+	const DWORD size = resource.size;
+	const mz_uint8* bytes = resource.bytes();
+	const DWORD eocdSize = 22;  // Size of the end of central directory record
+	const DWORD maxCommentSize = 0xFFFF;
+
+	lz4_frame_info info;
+	if (lz4_frame_parse_header(data, size, &info) && info.content_checksum) {
+		// LZ4 payload: hash the frame header and the content checksum at the end
+		update(bytes, info.header_size);
+		update(bytes + size - 4, 4);
+		return;
+	}
+	if (size >= eocdSize) {
+		DWORD scanEnd = (size - eocdSize > maxCommentSize) ? size - eocdSize - maxCommentSize : 0;
+		for (DWORD pos = size - eocdSize; ; --pos) {
+			if (bytes[pos] == 0x50 && bytes[pos + 1] == 0x4b && bytes[pos + 2] == 0x05 && bytes[pos + 3] == 0x06) {
+				DWORD cdSize = bytes[pos + 12] | (bytes[pos + 13] << 8) | (bytes[pos + 14] << 16) | ((DWORD)bytes[pos + 15] << 24);
+				DWORD cdOffset = bytes[pos + 16] | (bytes[pos + 17] << 8) | (bytes[pos + 18] << 16) | ((DWORD)bytes[pos + 19] << 24);
+				if (cdOffset <= pos && cdSize <= pos - cdOffset) {
+					// Hash the central directory and the end of central directory record
+					update(bytes + cdOffset, size - cdOffset);
+					return;
+				}
+				break;
+			}
+			if (pos == scanEnd) {
+				break;
+			}
+		}
+	}
+	update(bytes, size);
+}
+
+/**
+ * @brief Computes a content hash over several resources.
+ *
+ * The size of each resource is hashed along with its data (see
+ * `hashResourceData`) with SHA-256, so that different payloads do not end
+ * up with the same key. The key is the first `CONTENT_KEY_LENGTH` digits of
+ * the digest.
+ *
+ * @param resourceIDs The resources to hash, in order.
+ * @param digest If not NULL, receives the complete digest as a hexadecimal string.
+ * @return The key as a hexadecimal string.
+ * @throws std::runtime_error if a resource cannot be accessed or hashed.
+ */
+std::string hashResources(const std::vector<UINT>& resourceIDs, std::string* digest = NULL) {
+	BCRYPT_ALG_HANDLE algorithm = NULL;
+	BCRYPT_HASH_HANDLE hash = NULL;
+	if (!BCRYPT_SUCCESS(BCryptOpenAlgorithmProvider(&algorithm, BCRYPT_SHA256_ALGORITHM, NULL, 0))) {
+		throw std::runtime_error("SHA-256 is not available");
+	}
+	bool hashed = BCRYPT_SUCCESS(BCryptCreateHash(algorithm, &hash, NULL, 0, NULL, 0, 0));
+	auto update = [&](const void* data, size_t size) {
+		hashed = hashed && BCRYPT_SUCCESS(BCryptHashData(hash, static_cast<PUCHAR>(const_cast<void*>(data)), static_cast<ULONG>(size), 0));
+	};
+	UCHAR value[32];
+	try {
+		for (UINT resourceID : resourceIDs) {
+			const ResourceView resource = getResourceView(resourceID);
+			if (!resource) {
+				throw std::runtime_error("Failed to access resource " + std::to_string(resourceID));
+			}
+			update(&resource.size, sizeof(resource.size));
+			hashResourceData(resource, update);
+		}
+		hashed = hashed && BCRYPT_SUCCESS(BCryptFinishHash(hash, value, sizeof(value), 0));
+	} catch (...) {
+		if (hash != NULL) {
+			BCryptDestroyHash(hash);
+		}
+		BCryptCloseAlgorithmProvider(algorithm, 0);
+		throw;
+	}
+	if (hash != NULL) {
+		BCryptDestroyHash(hash);
+	}
+	BCryptCloseAlgorithmProvider(algorithm, 0);
+	if (!hashed) {
+		throw std::runtime_error("Failed to hash the resources");
+	}
+
+	std::string hex;
+	char digits[3];
+	for (UCHAR byte : value) {
+		snprintf(digits, sizeof(digits), "%02x", byte);
+		hex += digits;
+	}
+	if (digest != NULL) {
+		*digest = hex;
+	}
+	return hex.substr(0, CONTENT_KEY_LENGTH);
+}
+
+/**
+ * @brief Checks whether a directory name is a content key (see `hashResources`).
+ *
+ * Keys of earlier versions are included, so that their directories are
+ * still cleaned up.
+ *
+ * @param name The name, or the part of it after the prefix.
+ * @return True if the name consists of a content key.
+ */
+bool isContentKey(const std::string& name) {
+	return (name.size() == CONTENT_KEY_LENGTH || name.size() == LEGACY_CONTENT_KEY_LENGTH) &&
+		name.find_first_not_of("0123456789abcdef") == std::string::npos;
+}
+
+/**
+ * @brief Computes the cache key of the embedded payload.
+ *
+ * The key is derived from the content of the app contents, the selected
+ * runtime resources and the jpackage executable, so that each release of the
+ * embedded payload and each runtime profile gets its own cache directory.
+ *
+ * @return The cache key as a hexadecimal string.
+ * @throws std::runtime_error if a resource cannot be accessed.
+ */
+std::string getCacheKey() {
+	std::vector<UINT> resourceIDs = getRuntimeResources();
+	resourceIDs.insert(resourceIDs.begin(), IDR_APP_CONTENTS);
+	resourceIDs.push_back(IDR_APP_EXECUTABLE);
+	return hashResources(resourceIDs);
+}
+
+/**
+ * @brief Retrieves the cache directory path for the embedded payload.
+ *
+ * The cache directory is located next to where the run directory would be
+ * and its name combines the sanitized executable name with the cache key,
+ * e.g. `your-app-1a2b3c4d5e6f7a8b`. The directory is not created.
+ *
+ * @param exeFile The full path of the executable file.
+ * @param cacheKey The cache key of the embedded payload.
+ * @return The full path of the cache directory.
+ */
+std::string getCacheDirectory(const std::string& exeFile, const std::string& cacheKey) {
+	fs::path exePath(exeFile);
+	std::string sanitizedBaseName = sanitizeFileName(exePath.stem().string());
+	fs::path cacheDir = getRunParentDirectory(exePath) / (sanitizedBaseName + "-" + cacheKey);
+	return cacheDir.string();
+}
+
+/**
+ * @brief Checks whether a cache directory has been completely extracted.
+ *
+ * @param cacheDir The cache directory to check.
+ * @return True if the completion marker exists, false otherwise.
+ */
+bool isCacheComplete(const std::string& cacheDir) {
+	std::error_code ec;
+	return fs::exists(fs::path(cacheDir) / CACHE_MARKER_FILE, ec);
+}
+
+/**
+ * @brief Renames a directory to a tombstone, to be deleted later.
+ *
+ * Renaming is a single, atomic operation, so the original name is free again
+ * immediately. It fails while a process still has files in the directory open.
+ *
+ * @param dir The directory to retire.
+ * @return The path of the tombstone, or an empty path if the rename failed.
+ */
+fs::path moveToTombstone(const fs::path& dir) {
+	static std::atomic<unsigned> sequence(0);
+	std::error_code ec;
+	fs::path tombstone = dir;
+	tombstone += TOMBSTONE_MARKER + std::to_string(GetCurrentProcessId()) + "-" + std::to_string(GetTickCount64()) + "-" + std::to_string(sequence++);
+	fs::rename(dir, tombstone, ec);
+	if (ec) {
+		DEBUG_LOG("Failed to rename " + dir.string() + " to a tombstone: " + ec.message());
+		return fs::path();
+	}
+	DEBUG_LOG("Directory moved to tombstone: " + tombstone.string());
+	return tombstone;
+}
+
+/**
+ * @brief Deletes a directory tree, deleting the files on worker threads.
+ *
+ * Read-only files are made writable first. Directories are removed
+ * serially, deepest first, once all files are gone.
+ *
+ * @param dir The directory to delete.
+ * @param threads Number of worker threads, 0 for one per logical processor.
+ * @return True if the directory no longer exists, false otherwise.
+ */
+bool removeDirectoryParallel(const fs::path& dir, unsigned threads) {
+	unlinkSharedRuntime(dir);
+	std::vector<fs::path> files;
+	std::vector<fs::path> directories;
+	std::error_code ec;
+	for (fs::recursive_directory_iterator it(dir, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+		if (it->is_directory(ec) && !it->is_symlink(ec)) {
+			directories.push_back(it->path());
+		} else {
+			files.push_back(it->path());
+		}
+	}
+
+	std::atomic<size_t> nextFile(0);
+	runWorkers(getWorkerCount(threads, files.size() / 64), [&](unsigned) {
+		for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+			if (!DeleteFileW(files[i].c_str()) && GetLastError() == ERROR_ACCESS_DENIED) {
+				SetFileAttributesW(files[i].c_str(), FILE_ATTRIBUTE_NORMAL);
+				DeleteFileW(files[i].c_str());
+			}
+		}
+	});
+
+	// Pre-order iteration lists parents first, so remove in reverse order
+	for (auto it = directories.rbegin(); it != directories.rend(); ++it) {
+		RemoveDirectoryW(it->c_str());
+	}
+	RemoveDirectoryW(dir.c_str());
+	return !fs::exists(dir, ec);
+}
+
+/**
+ * @brief Deletes all tombstones in a directory.
+ *
+ * This is the work of the detached purge process (`--wjl-purge`). Tombstones
+ * that cannot be deleted completely are left for the next purge.
+ *
+ * @param parentDir The directory containing the tombstones.
+ * @return True if all tombstones were deleted, false otherwise.
+ */
+bool purgeTombstones(const fs::path& parentDir) {
+	bool success = true;
+	std::error_code ec;
+	std::vector<fs::path> tombstones;
+	for (const auto& entry : fs::directory_iterator(parentDir, ec)) {
+		if (entry.path().filename().string().find(TOMBSTONE_MARKER) != std::string::npos && entry.is_directory(ec)) {
+			tombstones.push_back(entry.path());
+		}
+	}
+	for (const fs::path& tombstone : tombstones) {
+		if (removeDirectoryParallel(tombstone, EXTRACTION_THREADS)) {
+			DEBUG_LOG("Tombstone deleted: " + tombstone.string());
+		} else {
+			printErrorInfo("Failed to delete tombstone: " + tombstone.string());
+			success = false;
+		}
+	}
+	return success;
+}
+
+/**
+ * @brief Starts a detached, low-priority copy of the launcher for cleanup work.
+ *
+ * The launcher starts itself at idle priority with the given arguments and
+ * does not wait for it, so it can exit right away.
+ *
+ * @param arguments The command-line arguments, e.g. `--wjl-purge "<dir>"`.
+ * @param workingDir The working directory of the process.
+ * @return True if the process was started, false otherwise.
+ */
+bool startCleanupProcess(const std::string& arguments, const fs::path& workingDir) {
+	char exePath[MAX_PATH];
+	DWORD length = GetModuleFileNameA(NULL, exePath, MAX_PATH);
+	if (length == 0 || length >= MAX_PATH) {
+		printErrorInfo("Failed to get launcher path. Error Code: " + std::to_string(GetLastError()));
+		return false;
+	}
+	std::string commandLine = "\"" + std::string(exePath) + "\" " + arguments;
+
+	STARTUPINFO si = {0};
+	si.cb = sizeof(si);
+	PROCESS_INFORMATION pi = {0};
+	// Break away from the job of the process limits, which may terminate its
+	// processes when the launcher exits; a job forbidding it is kept
+	const DWORD flags = DETACHED_PROCESS | IDLE_PRIORITY_CLASS;
+	if (!CreateProcess(exePath, &commandLine[0], NULL, NULL, FALSE, flags | CREATE_BREAKAWAY_FROM_JOB, NULL, workingDir.string().c_str(), &si, &pi) &&
+		!CreateProcess(exePath, &commandLine[0], NULL, NULL, FALSE, flags, NULL, workingDir.string().c_str(), &si, &pi)) {
+		printErrorInfo("Failed to start cleanup process. Error Code: " + std::to_string(GetLastError()));
+		return false;
+	}
+	CloseHandle(pi.hProcess);
+	CloseHandle(pi.hThread);
+	DEBUG_LOG("Cleanup process started: " + arguments);
+	return true;
+}
+
+/**
+ * @brief Starts a detached, low-priority process deleting the tombstones.
+ *
+ * If the process cannot be started, the tombstones are deleted by the purge
+ * of a later launch.
+ *
+ * @param parentDir The directory containing the tombstones.
+ * @return True if the process was started, false otherwise.
+ */
+bool startTombstonePurge(const fs::path& parentDir) {
+	return startCleanupProcess(PURGE_SWITCH + " \"" + parentDir.string() + "\"", parentDir);
+}
+
+/**
+ * @brief Starts a detached process deleting a directory once the launcher exits.
+ *
+ * Used when the launcher itself keeps files of the directory in use, such as
+ * the DLLs of an in-process JVM, which can only be deleted after it exits.
+ *
+ * @param dir The directory to delete.
+ * @return True if the process was started, false otherwise.
+ */
+bool startDelayedRemoval(const fs::path& dir) {
+	return startCleanupProcess(REMOVE_SWITCH + " \"" + dir.string() + "\" " + std::to_string(GetCurrentProcessId()), dir.parent_path());
+}
+
+/**
+ * @brief Runs the cleanup work if the launcher was started for it.
+ *
+ * `--wjl-purge <dir>` deletes the tombstones in a directory,
+ * `--wjl-remove <dir> <pid>` waits for a process to exit and then deletes
+ * the directory.
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv The command-line arguments.
+ * @param exitCode Receives the exit code of the cleanup.
+ * @return True if this process is a cleanup process and has done its work.
+ */
+bool runCleanupProcess(int argc, char* argv[], int& exitCode) {
+	bool purge = (argc == 3 && PURGE_SWITCH == argv[1]);
+	bool remove = (argc == 4 && REMOVE_SWITCH == argv[1]);
+	if (!purge && !remove) {
+		return false;
+	}
+	// Background mode also lowers the I/O and memory priority
+	SetPriorityClass(GetCurrentProcess(), PROCESS_MODE_BACKGROUND_BEGIN);
+	if (purge) {
+		exitCode = purgeTombstones(argv[2]) ? 0 : 1;
+	} else {
+		HANDLE hProcess = OpenProcess(SYNCHRONIZE, FALSE, static_cast<DWORD>(strtoul(argv[3], NULL, 10)));
+		if (hProcess != NULL) {
+			WaitForSingleObject(hProcess, INFINITE);
+			CloseHandle(hProcess);
+		}
+		exitCode = removeDirectoryParallel(argv[2], EXTRACTION_THREADS) ? 0 : 1;
+	}
+	return true;
+}
+
+/**
+ * @brief Deletes a directory unless the files in it are in use.
+ *
+ * The directory is first renamed to a tombstone, which fails while a process
+ * is still running from it, and only then deleted. With `ASYNC_CLEANUP` the
+ * tombstone is left to the purge process.
+ *
+ * @param dir The directory to delete.
+ * @return True if the directory was deleted or retired, false if it is in use.
+ */
+bool removeUnusedDirectory(const fs::path& dir) {
+	fs::path tombstone = moveToTombstone(dir);
+	if (tombstone.empty()) {
+		return false;
+	}
+	if (!ASYNC_CLEANUP) {
+		std::error_code ec;
+		unlinkSharedRuntime(tombstone);
+		fs::remove_all(tombstone, ec);
+	}
+	return true;
+}
+
+/**
+ * @brief Lists the cache directories of other payload versions.
+ *
+ * @param exeFile The full path of the executable file.
+ * @param cacheDir The current cache directory, which is not listed.
+ * @return The cache directories of the same executable with another key.
+ */
+std::vector<fs::path> getStaleCacheDirectories(const std::string& exeFile, const std::string& cacheDir) {
+	std::vector<fs::path> stale;
+	fs::path current(cacheDir);
+	const std::string prefix = sanitizeFileName(fs::path(exeFile).stem().string()) + "-";
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator(current.parent_path(), ec)) {
+		const std::string name = entry.path().filename().string();
+		if (entry.path() == current || name.compare(0, prefix.size(), prefix) != 0) {
+			continue;
+		}
+		if (!isContentKey(name.substr(prefix.size())) || !entry.is_directory(ec)) {
+			continue;
+		}
+		stale.push_back(entry.path());
+	}
+	return stale;
+}
+
+/**
+ * @brief Removes cache directories of previous payload versions.
+ *
+ * Stale directories are first renamed, which fails while a previous version
+ * is still running from them, and only then deleted. Failures are ignored;
+ * the directories are retried on the next launch.
+ *
+ * @param exeFile The full path of the executable file.
+ * @param cacheDir The current cache directory, which is kept.
+ * @return The number of directories removed.
+ */
+size_t pruneCacheDirectories(const std::string& exeFile, const std::string& cacheDir) {
+	size_t removed = 0;
+	for (const fs::path& dir : getStaleCacheDirectories(exeFile, cacheDir)) {
+		if (removeUnusedDirectory(dir)) {
+			++removed;
+			DEBUG_LOG("Stale cache directory removed: " + dir.string());
+		} else {
+			DEBUG_LOG("Stale cache directory in use, skipped: " + dir.string());
+		}
+	}
+	return removed;
+}
+
+/**
+ * @brief Lists the entries of the embedded zip archives.
+ *
+ * Only the central directories are read. LZ4 payloads carry no checksums
+ * per entry and have no manifest. A shared runtime is not listed.
+ *
+ * @param manifest Receives the entries of both archives.
+ * @return True if both archives are zip archives and could be read.
+ */
+bool getPayloadManifest(Manifest& manifest) {
+	std::vector<UINT> resourceIDs = { IDR_APP_CONTENTS };
+	if (!SHARED_RUNTIME) {
+		// A shared runtime is linked from the runtime store, not extracted
+		const std::vector<UINT> runtimeIDs = getRuntimeResources();
+		resourceIDs.insert(resourceIDs.end(), runtimeIDs.begin(), runtimeIDs.end());
+	}
+	for (UINT resourceID : resourceIDs) {
+		const ResourceView resource = getResourceView(resourceID);
+		mz_zip_archive zip;
+		memset(&zip, 0, sizeof(zip));
+		if (!resource || !mz_zip_reader_init_mem(&zip, resource.data, resource.size, MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)) {
+			return false;
+		}
+		mz_uint num_files = mz_zip_reader_get_num_files(&zip);
+		for (mz_uint i = 0; i < num_files; ++i) {
+			mz_zip_archive_file_stat stat;
+			if (!mz_zip_reader_file_stat(&zip, i, &stat)) {
+				mz_zip_reader_end(&zip);
+				return false;
+			}
+			std::string name = stat.m_filename;
+			if (stat.m_is_directory && (name.empty() || name.back() != '/')) {
+				name += '/';
+			}
+			manifest[name] = { stat.m_crc32, stat.m_is_directory ? 0 : stat.m_uncomp_size };
+		}
+		mz_zip_reader_end(&zip);
+	}
+	return true;
+}
+
+/**
+ * @brief Writes the manifest file of a cache directory.
+ *
+ * Each line holds the CRC-32 (hex), the size and the name of an entry.
+ *
+ * @param dir The cache directory.
+ * @param manifest The extracted entries.
+ * @return True if the manifest was written, false otherwise.
+ */
+bool writeManifest(const fs::path& dir, const Manifest& manifest) {
+	std::ofstream file(dir / MANIFEST_FILE);
+	for (const auto& entry : manifest) {
+		char crc[9];
+		snprintf(crc, sizeof(crc), "%08lx", static_cast<unsigned long>(entry.second.crc32));
+		file << crc << " " << entry.second.size << " " << entry.first << "\n";
+	}
+	file.close();
+	return !file.fail();
+}
+
+/**
+ * @brief Reads the manifest file of a cache directory.
+ *
+ * @param dir The cache directory.
+ * @param manifest Receives the extracted entries.
+ * @return True if the manifest was read, false if it is missing or malformed.
+ */
+bool readManifest(const fs::path& dir, Manifest& manifest) {
+	std::ifstream file(dir / MANIFEST_FILE);
+	if (!file.is_open()) {
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		size_t sizeStart = line.find(' ');
+		size_t nameStart = (sizeStart == std::string::npos) ? std::string::npos : line.find(' ', sizeStart + 1);
+		if (nameStart == std::string::npos || nameStart + 1 >= line.size()) {
+			return false;
+		}
+		try {
+			ManifestEntry entry;
+			entry.crc32 = static_cast<mz_uint32>(std::stoul(line.substr(0, sizeStart), NULL, 16));
+			entry.size = std::stoull(line.substr(sizeStart + 1, nameStart - sizeStart - 1));
+			manifest[line.substr(nameStart + 1)] = entry;
+		} catch (const std::exception&) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Takes over the cache directory of the previous payload version.
+ *
+ * The most recently completed cache directory with a manifest is renamed to
+ * the staging directory, which fails while the previous version is still
+ * running from it. Files whose entries were changed or removed from the
+ * payload are deleted (changed files may be hard links, so they are not
+ * overwritten in place), together with the launcher's own files (marker,
+ * manifest, class data sharing archive). Files whose CRC-32 and size are
+ * unchanged are kept and returned; all other entries remain to be extracted.
+ *
+ * @param exeFile The full path of the executable file.
+ * @param cacheDir The cache directory to populate.
+ * @param stagingDir The staging directory to create from the previous version.
+ * @return The unchanged files, or NULL if there is no directory to take over.
+ */
+std::shared_ptr<Manifest> takeOverPreviousCache(const std::string& exeFile, const std::string& cacheDir, const std::string& stagingDir) {
+	fs::path previous;
+	fs::file_time_type previousTime;
+	std::error_code ec;
+	for (const fs::path& dir : getStaleCacheDirectories(exeFile, cacheDir)) {
+		fs::file_time_type time = fs::last_write_time(dir / CACHE_MARKER_FILE, ec);
+		if (!ec && fs::exists(dir / MANIFEST_FILE, ec) && (previous.empty() || time > previousTime)) {
+			previous = dir;
+			previousTime = time;
+		}
+	}
+	Manifest current;
+	Manifest old;
+	if (previous.empty() || !getPayloadManifest(current) || !readManifest(previous, old)) {
+		return NULL;
+	}
+	fs::rename(previous, stagingDir, ec);
+	if (ec) {
+		DEBUG_LOG("Previous cache directory in use, extracting all entries: " + previous.string());
+		return NULL;
+	}
+
+	LONGLONG start = getTimestamp();
+	const fs::path staging(stagingDir);
+	unlinkSharedRuntime(staging);  // Linked again after the extraction
+	fs::remove(staging / CACHE_MARKER_FILE, ec);
+	fs::remove(staging / MANIFEST_FILE, ec);
+	fs::remove(staging / CDS_ARCHIVE_FILE, ec);
+	std::shared_ptr<Manifest> unchanged = std::make_shared<Manifest>();
+	std::vector<fs::path> removedDirectories;
+	for (const auto& entry : old) {
+		const fs::path path = staging / entry.first;
+		const bool isDirectory = entry.first.back() == '/';
+		auto next = current.find(entry.first);
+		if (next == current.end()) {
+			if (isDirectory) {
+				removedDirectories.push_back(path);
+			} else {
+				fs::remove(path, ec);
+			}
+		} else if (!isDirectory && next->second.crc32 == entry.second.crc32 && next->second.size == entry.second.size &&
+				fs::file_size(path, ec) == entry.second.size && !ec) {
+			unchanged->insert(entry);
+		} else if (!isDirectory) {
+			// Not overwritten in place: the file may be a hard link shared with an unchanged one
+			fs::remove(path, ec);
+		}
+	}
+	// Deepest directories first; directories still holding files are kept
+	std::sort(removedDirectories.begin(), removedDirectories.end(), [](const fs::path& a, const fs::path& b) { return a.native().size() > b.native().size(); });
+	for (const fs::path& dir : removedDirectories) {
+		fs::remove(dir, ec);
+	}
+	recordTiming("delta", previous.string(), start, 0, unchanged->size());
+	DEBUG_LOG("Delta extraction from " + previous.string() + ": " + std::to_string(unchanged->size()) + " of " + std::to_string(current.size()) + " entries unchanged");
+	return unchanged;
+}
+
+/**
+ * @brief Retrieves the store directory for the embedded runtime contents.
+ *
+ * The directory is named after a content hash of the selected runtime
+ * resources, so launchers of different applications embedding the same
+ * runtime with the same modules share it.
+ *
+ * @param digest If not NULL, receives the complete SHA-256 of the runtime,
+ *        which the completion marker of the store directory holds.
+ * @return The store directory, e.g. `%LOCALAPPDATA%\WinJavaLauncher\runtimes\1a2b3c4d5e6f7a8b`.
+ * @throws std::runtime_error if the runtime resource cannot be accessed.
+ */
+std::string getSharedRuntimeDirectory(std::string* digest = NULL) {
+	const std::string key = hashResources(getRuntimeResources(), digest);
+
+	char localAppData[MAX_PATH];
+	DWORD length = GetEnvironmentVariableA("LOCALAPPDATA", localAppData, sizeof(localAppData));
+	fs::path root = (length > 0 && length < sizeof(localAppData)) ? fs::path(localAppData) : fs::path(getTempDirectory());
+	return (root / RUNTIME_STORE_DIRECTORY / key).string();
+}
+
+/**
+ * @brief Creates a directory junction.
+ *
+ * Unlike symbolic links, junctions need no privilege. The mount point
+ * reparse data is not declared by the MinGW headers, so it is laid out here.
+ *
+ * @param link The junction to create; must not exist.
+ * @param target The absolute path of the target directory.
+ * @return True if the junction was created, false otherwise.
+ */
+bool createJunction(const fs::path& link, const fs::path& target) {
+	struct MountPointReparseBuffer {
+		DWORD ReparseTag;
+		WORD ReparseDataLength;
+		WORD Reserved;
+		WORD SubstituteNameOffset;
+		WORD SubstituteNameLength;
+		WORD PrintNameOffset;
+		WORD PrintNameLength;
+		WCHAR PathBuffer[1];
+	};
+	const std::wstring substituteName = L"\\??\\" + target.wstring();
+	const std::wstring printName = target.wstring();
+	const size_t pathBytes = (substituteName.size() + 1 + printName.size() + 1) * sizeof(WCHAR);
+	const size_t headerBytes = offsetof(MountPointReparseBuffer, PathBuffer);
+	std::vector<BYTE> buffer(headerBytes + pathBytes, 0);
+	MountPointReparseBuffer* reparse = reinterpret_cast<MountPointReparseBuffer*>(buffer.data());
+	reparse->ReparseTag = IO_REPARSE_TAG_MOUNT_POINT;
+	reparse->ReparseDataLength = static_cast<WORD>(buffer.size() - offsetof(MountPointReparseBuffer, SubstituteNameOffset));
+	reparse->SubstituteNameLength = static_cast<WORD>(substituteName.size() * sizeof(WCHAR));
+	reparse->PrintNameOffset = static_cast<WORD>((substituteName.size() + 1) * sizeof(WCHAR));
+	reparse->PrintNameLength = static_cast<WORD>(printName.size() * sizeof(WCHAR));
+	memcpy(reparse->PathBuffer, substituteName.c_str(), reparse->SubstituteNameLength);
+	memcpy(reinterpret_cast<BYTE*>(reparse->PathBuffer) + reparse->PrintNameOffset, printName.c_str(), reparse->PrintNameLength);
+
+	if (!CreateDirectoryW(link.c_str(), NULL)) {
+		return false;
+	}
+	HANDLE hLink = CreateFileW(link.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OPEN_REPARSE_POINT, NULL);
+	DWORD returned = 0;
+	bool created = hLink != INVALID_HANDLE_VALUE &&
+		DeviceIoControl(hLink, FSCTL_SET_REPARSE_POINT, buffer.data(), static_cast<DWORD>(buffer.size()), NULL, 0, &returned, NULL);
+	if (hLink != INVALID_HANDLE_VALUE) {
+		CloseHandle(hLink);
+	}
+	if (!created) {
+		RemoveDirectoryW(link.c_str());
+	}
+	return created;
+}
+
+/**
+ * @brief Registers this launcher as a user of a shared runtime.
+ *
+ * Each launcher keeps a file in the `.refs` directory of the runtime open
+ * until it exits; the file is deleted on close, also if the launcher is
+ * terminated. As long as one is open, the runtime directory cannot be
+ * renamed, which keeps `pruneSharedRuntimes` from removing it. The
+ * completion marker is touched to record the last use.
+ *
+ * @param storeDir The store directory of the runtime.
+ * @return True if the reference was taken, false if the runtime is gone.
+ */
+bool acquireRuntimeReference(const fs::path& storeDir) {
+	static HANDLE hReference = INVALID_HANDLE_VALUE;
+	if (hReference != INVALID_HANDLE_VALUE) {
+		return true;
+	}
+	std::error_code ec;
+	if (!fs::exists(storeDir / CACHE_MARKER_FILE, ec)) {
+		return false;
+	}
+	fs::create_directories(storeDir / ".refs", ec);
+	const fs::path referenceFile = storeDir / ".refs" / (std::to_string(GetCurrentProcessId()) + "-" + std::to_string(GetTickCount64()));
+	hReference = CreateFileW(referenceFile.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, CREATE_NEW,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	if (hReference == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	fs::last_write_time(storeDir / CACHE_MARKER_FILE, fs::file_time_type::clock::now(), ec);
+	return true;
+}
+
+/**
+ * @brief Removes shared runtimes that have not been used for a while.
+ *
+ * Runtimes referenced by a running launcher, or used within the last
+ * `RUNTIME_RETENTION_DAYS` days, are kept. Like stale cache directories, the
+ * runtimes are renamed to tombstones before they are deleted.
+ *
+ * @param storeDir The store directory of the current runtime, which is kept.
+ * @return The number of runtimes removed.
+ */
+size_t pruneSharedRuntimes(const fs::path& storeDir) {
+	size_t removed = 0;
+	std::error_code ec;
+	const auto cutoff = fs::file_time_type::clock::now() - std::chrono::hours(24 * RUNTIME_RETENTION_DAYS);
+	for (const auto& entry : fs::directory_iterator(storeDir.parent_path(), ec)) {
+		const std::string name = entry.path().filename().string();
+		if (entry.path() == storeDir || !isContentKey(name) || !entry.is_directory(ec)) {
+			continue;
+		}
+		fs::file_time_type lastUse = fs::last_write_time(entry.path() / CACHE_MARKER_FILE, ec);
+		if (!ec && lastUse > cutoff) {
+			continue;
+		}
+		if (!fs::is_empty(entry.path() / ".refs", ec) && !ec) {
+			continue;
+		}
+		if (removeUnusedDirectory(entry.path())) {
+			++removed;
+			DEBUG_LOG("Unused shared runtime removed: " + entry.path().string());
+		}
+	}
+	return removed;
+}
+
+/**
+ * @brief Links the shared runtime into a run directory.
+ *
+ * The runtime is extracted into the store first if it is not there yet: into
+ * a private staging directory, which is renamed once it is complete, as for
+ * the extraction cache. Its completion marker holds the SHA-256 of the
+ * runtime, which is compared before linking, so that a runtime is never
+ * linked from a store directory holding another one. The `runtime`
+ * directory of the run directory is then created as a junction to the
+ * runtime in the store.
+ *
+ * @param targetDir The run directory.
+ * @param threads Number of worker threads for extracting the runtime.
+ * @return True if the runtime is linked, false otherwise.
+ */
+bool linkSharedRuntime(const std::string& targetDir, unsigned threads) {
+	try {
+		LONGLONG start = getTimestamp();
+		std::string digest;
+		const fs::path storeDir = getSharedRuntimeDirectory(&digest);
+		std::error_code ec;
+		// A store directory being pruned in the meantime is extracted again
+		for (int attempt = 0; !acquireRuntimeReference(storeDir); ++attempt) {
+			if (attempt == 2) {
+				throw std::runtime_error("Failed to reference shared runtime: " + storeDir.string());
+			}
+			DEBUG_LOG("Shared runtime miss: " + storeDir.string());
+			const fs::path stagingDir = storeDir.string() + ".tmp-" + std::to_string(GetCurrentProcessId());
+			fs::remove_all(stagingDir, ec);
+			fs::create_directories(stagingDir);
+			bool extracted = true;
+			for (UINT resourceID : getRuntimeResources()) {
+				extracted = extracted && unzipResource(resourceID, stagingDir.string(), threads);
+			}
+			if (!extracted || !(std::ofstream(stagingDir / CACHE_MARKER_FILE) << digest << std::endl)) {
+				fs::remove_all(stagingDir, ec);
+				throw std::runtime_error("Failed to extract shared runtime: " + storeDir.string());
+			}
+			if (fs::exists(storeDir, ec) && !fs::exists(storeDir / CACHE_MARKER_FILE, ec)) {
+				removeUnusedDirectory(storeDir);  // Left over from an interrupted extraction
+			}
+			fs::rename(stagingDir, storeDir, ec);
+			if (ec) {
+				fs::remove_all(stagingDir, ec);  // Another launcher was faster
+			}
+			if (pruneSharedRuntimes(storeDir) > 0 && ASYNC_CLEANUP) {
+				startTombstonePurge(storeDir.parent_path());
+			}
+		}
+		std::string stored;
+		std::ifstream marker(storeDir / CACHE_MARKER_FILE);
+		if (!std::getline(marker, stored) || stored != digest) {
+			throw std::runtime_error("The shared runtime store holds another runtime: " + storeDir.string());
+		}
+
+		const fs::path link = fs::path(targetDir) / "runtime";
+		DWORD attributes = GetFileAttributesW(link.c_str());
+		if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) {
+			removeDirectoryParallel(link, threads);  // A private runtime from before
+		}
+		if ((attributes == INVALID_FILE_ATTRIBUTES || (attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0) && !createJunction(link, storeDir / "runtime")) {
+			throw std::runtime_error("Failed to link shared runtime. Error Code: " + std::to_string(GetLastError()));
+		}
+		recordTiming("shared_runtime", storeDir.string(), start);
+		DEBUG_LOG("Shared runtime linked: " + link.string() + " -> " + storeDir.string());
+		return true;
+	} catch (const std::exception& e) {
+		printErrorInfo("Shared runtime failed: " + std::string(e.what()));
+	}
+	return false;
+}
+
+/**
+ * @brief Extracts the embedded payload into a directory.
+ *
+ * The jpackage executable, the app contents and the runtime contents are
+ * independent of each other and are extracted concurrently, so the total
+ * time is that of the longest step rather than the sum of all of them. The
+ * extraction workers are split between the archives by compressed size; the
+ * runtime modules selected by the runtime profile are extracted alongside
+ * the base runtime (see `getRuntimeResources`).
+ * With `SHARED_RUNTIME`, the runtime is linked from the runtime store
+ * instead (see `linkSharedRuntime`).
+ *
+ * @param exeFile The name of the jpackage executable.
+ * @param targetDir Directory where the payload will be extracted.
+ * @param pass The entries to extract; the executable is part of the boot set.
+ * @param unchanged Zip entries already extracted to `targetDir`, or NULL.
+ * @return True if all resources were extracted, false otherwise.
+ */
+bool extractPayload(const std::string& exeFile, const std::string& targetDir, ExtractionPass pass = ExtractionPass::All, const Manifest* unchanged = NULL) {
+	// Split the extraction workers between the archives by compressed size
+	const std::vector<UINT> runtimeIDs = getRuntimeResources();
+	const DWORD appSize = getResourceView(IDR_APP_CONTENTS).size;
+	mz_uint64 runtimeSize = 0;
+	std::vector<DWORD> runtimeSizes(runtimeIDs.size(), 0);
+	for (size_t i = 0; i < runtimeIDs.size(); ++i) {
+		runtimeSizes[i] = getResourceView(runtimeIDs[i]).size;
+		runtimeSize += runtimeSizes[i];
+	}
+	if (SHARED_RUNTIME && pass != ExtractionPass::Deferred) {
+		// Nothing to extract for the runtime if it is already in the store
+		std::error_code ec;
+		if (fs::exists(fs::path(getSharedRuntimeDirectory()) / CACHE_MARKER_FILE, ec)) {
+			runtimeSize = 0;
+		}
+	}
+	unsigned workers = getWorkerCount(EXTRACTION_THREADS, MAX_WORKER_THREADS);
+	unsigned appWorkers = 1;
+	if (workers > 2 && appSize + runtimeSize > 0) {
+		appWorkers = std::max(1u, static_cast<unsigned>(static_cast<mz_uint64>(workers) * appSize / (static_cast<mz_uint64>(appSize) + runtimeSize)));
+	}
+	unsigned runtimeWorkers = std::max(1u, workers > appWorkers ? workers - appWorkers : 1u);
+	if (pass == ExtractionPass::Deferred) {
+		// Keep the deferred pass from competing with the starting application
+		appWorkers = 1;
+		runtimeWorkers = 1;
+	}
+
+	// The executable and both archives go to separate paths, so they are
+	// extracted concurrently; the pipeline joins before returning
+	std::vector<std::function<bool()>> tasks = {
+		[&]() { return unzipResource(IDR_APP_CONTENTS, targetDir, appWorkers, pass, unchanged); }
+	};
+	if (SHARED_RUNTIME) {
+		tasks.push_back([&]() {
+			// The store holds the complete runtime, the deferred pass has nothing left to do
+			return pass == ExtractionPass::Deferred || linkSharedRuntime(targetDir, runtimeWorkers);
+		});
+	} else {
+		for (size_t i = 0; i < runtimeIDs.size(); ++i) {
+			// The runtime workers are split between the base runtime and the modules
+			unsigned moduleWorkers = 1;
+			if (runtimeSize > 0) {
+				moduleWorkers = std::max(1u, static_cast<unsigned>(static_cast<mz_uint64>(runtimeWorkers) * runtimeSizes[i] / runtimeSize));
+			}
+			tasks.push_back([&, i, moduleWorkers]() {
+				return unzipResource(runtimeIDs[i], targetDir, moduleWorkers, pass, unchanged);
+			});
+		}
+	}
+	if (pass != ExtractionPass::Deferred) {
+		tasks.push_back([&]() {
+			return extractResource(IDR_APP_EXECUTABLE, targetDir + "\\" + exeFile);
+		});
+	}
+	return runTasks(tasks);
+}
+
+/**
+ * @brief Writes the completion marker into a cache directory.
+ *
+ * With `DELTA_EXTRACTION`, the manifest of the zip entries is written first,
+ * so that the next payload version can be extracted as a delta.
+ *
+ * @param dir The directory to mark as completely extracted.
+ * @param cacheDir The cache directory the marker belongs to.
+ * @return True if the marker was written, false otherwise.
+ */
+bool writeCacheMarker(const std::string& dir, const std::string& cacheDir) {
+	Manifest manifest;
+	if (DELTA_EXTRACTION && getPayloadManifest(manifest) && !writeManifest(dir, manifest)) {
+		return false;
+	}
+	std::ofstream marker(fs::path(dir) / CACHE_MARKER_FILE);
+	marker << fs::path(cacheDir).filename().string() << std::endl;
+	marker.close();
+	return !marker.fail();
+}
+
+/**
+ * @brief Moves a staging directory into place as the cache directory.
+ *
+ * A left-over incomplete cache directory, e.g. from an interrupted launch,
+ * is removed first unless another launch is still running from it.
+ *
+ * @param stagingDir The staging directory to move.
+ * @param cacheDir The cache directory.
+ * @return True if the staging directory was moved, false if another launch
+ *         completed the cache directory in the meantime.
+ * @throws std::runtime_error if the cache directory cannot be installed.
+ */
+bool installStagingDirectory(const std::string& stagingDir, const std::string& cacheDir) {
+	std::error_code ec;
+	if (fs::exists(cacheDir, ec) && !isCacheComplete(cacheDir)) {
+		removeUnusedDirectory(cacheDir);
+	}
+	fs::rename(stagingDir, cacheDir, ec);
+	if (!ec) {
+		return true;
+	}
+	fs::remove_all(stagingDir, ec);
+	if (!isCacheComplete(cacheDir)) {
+		throw std::runtime_error("Failed to move staging directory into cache: " + cacheDir);
+	}
+	return false;
+}
+
+/**
+ * @brief Populates the cache directory unless it is already complete.
+ *
+ * On a warm start the completion marker is found and the directory is
+ * returned immediately. Otherwise the payload is extracted into a private
+ * staging directory, the marker is written and the staging directory is
+ * renamed to the cache directory, so that concurrent launches never see a
+ * partially extracted cache.
+ *
+ * With `DELTA_EXTRACTION`, the staging directory is created from the cache
+ * directory of the previous payload version if it is not in use, and only
+ * the changed and new zip entries are extracted into it.
+ *
+ * With `EARLY_LAUNCH`, only the boot set is extracted before the staging
+ * directory is moved into place. The remaining entries are then extracted
+ * by the given background task, which writes the marker once it completes.
+ *
+ * @param exeFile The name of the jpackage executable.
+ * @param cacheDir The cache directory to populate.
+ * @param deferred Background task for the deferred extraction pass.
+ * @return The directory to run the application from.
+ * @throws std::runtime_error if the payload cannot be extracted.
+ */
+std::string prepareCacheDirectory(const std::string& exeFile, const std::string& cacheDir, BackgroundTask& deferred) {
+	if (isCacheComplete(cacheDir)) {
+		DEBUG_LOG("Extraction cache hit: " + cacheDir);
+		traceCacheLookup(cacheDir, true);
+		// Take a reference, and extract the runtime again if it was pruned from the store
+		if (SHARED_RUNTIME && !linkSharedRuntime(cacheDir, EXTRACTION_THREADS)) {
+			throw std::runtime_error("Failed to link shared runtime into cache: " + cacheDir);
+		}
+		return cacheDir;
+	}
+	DEBUG_LOG("Extraction cache miss: " + cacheDir);
+	traceCacheLookup(cacheDir, false);
+
+	std::error_code ec;
+	const std::string stagingDir = cacheDir + ".tmp-" + std::to_string(GetCurrentProcessId());
+	fs::remove_all(stagingDir, ec);
+
+	// Start from the previous payload version and write only what changed
+	std::shared_ptr<Manifest> unchanged = DELTA_EXTRACTION ? takeOverPreviousCache(exeFile, cacheDir, stagingDir) : NULL;
+	fs::create_directories(stagingDir);
+
+	if (!extractPayload(exeFile, stagingDir, EARLY_LAUNCH ? ExtractionPass::Boot : ExtractionPass::All, unchanged.get())) {
+		fs::remove_all(stagingDir, ec);
+		throw std::runtime_error("Failed to extract payload into cache: " + cacheDir);
+	}
+
+	if (EARLY_LAUNCH) {
+		if (installStagingDirectory(stagingDir, cacheDir)) {
+			startBackgroundTask(deferred, [exeFile, cacheDir, unchanged]() {
+				return extractPayload(exeFile, cacheDir, ExtractionPass::Deferred, unchanged.get()) && writeCacheMarker(cacheDir, cacheDir);
+			});
+		}
+		return cacheDir;
+	}
+
+	if (!writeCacheMarker(stagingDir, cacheDir)) {
+		fs::remove_all(stagingDir, ec);
+		throw std::runtime_error("Failed to write cache marker: " + cacheDir);
+	}
+	installStagingDirectory(stagingDir, cacheDir);
+	DEBUG_LOG("Extraction cache populated: " + cacheDir);
+	return cacheDir;
+}
+
+/**
+ * @brief Returns the lock file handle of a training launch.
+ *
+ * @return The handle; `INVALID_HANDLE_VALUE` unless this launch trains.
+ */
+HANDLE& getTrainingLock() {
+	static HANDLE lock = INVALID_HANDLE_VALUE;
+	return lock;
+}
+
+/**
+ * @brief Returns the JVM option selecting the class data sharing archive.
+ *
+ * If the archive of the cache directory exists, it is used. Otherwise this
+ * launch is a training launch that writes the archive into a file of its own
+ * when the JVM exits; `installSharedArchive` moves it into place. Only one
+ * launch at a time trains, the one holding `CDS_LOCK_FILE`; launches started
+ * meanwhile run without an archive.
+ *
+ * @param runDir The cache directory the application runs from.
+ * @return The UTF-8 `-XX:SharedArchiveFile` or `-XX:ArchiveClassesAtExit`
+ *         option; empty if another launch is training.
+ */
+std::string getSharedArchiveOption(const std::string& runDir) {
+	const fs::path archive = fs::path(runDir) / CDS_ARCHIVE_FILE;
+	std::error_code ec;
+	if (fs::exists(archive, ec)) {
+		DEBUG_LOG("Using class data sharing archive: " + archive.string());
+		return "-XX:SharedArchiveFile=" + archive.u8string();
+	}
+	// Not shared, and deleted when the launcher exits, even if it crashes
+	HANDLE& lock = getTrainingLock();
+	if (lock == INVALID_HANDLE_VALUE) {
+		lock = CreateFileW((fs::path(runDir) / CDS_LOCK_FILE).c_str(), GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_HIDDEN | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	}
+	if (lock == INVALID_HANDLE_VALUE) {
+		DEBUG_LOG("Another launch is creating the class data sharing archive: " + archive.string());
+		return "";
+	}
+	DEBUG_LOG("Training launch, creating class data sharing archive: " + archive.string());
+	return "-XX:ArchiveClassesAtExit=" + archive.u8string() + "." + std::to_string(GetCurrentProcessId());
+}
+
+/**
+ * @brief Moves the archive written by a training launch into place.
+ *
+ * If the application did not exit normally, no archive was written and the
+ * next launch trains again. The training lock is released.
+ *
+ * @param runDir The cache directory the application ran from.
+ */
+void installSharedArchive(const std::string& runDir) {
+	const fs::path archive = fs::path(runDir) / CDS_ARCHIVE_FILE;
+	const fs::path trained = archive.string() + "." + std::to_string(GetCurrentProcessId());
+	std::error_code ec;
+	if (fs::exists(trained, ec)) {
+		if (MoveFileExW(trained.c_str(), archive.c_str(), MOVEFILE_WRITE_THROUGH)) {
+			DEBUG_LOG("Class data sharing archive created: " + archive.string());
+		} else {
+			fs::remove(trained, ec);
+		}
+	}
+	HANDLE& lock = getTrainingLock();
+	if (lock != INVALID_HANDLE_VALUE) {
+		CloseHandle(lock);
+		lock = INVALID_HANDLE_VALUE;
+	}
+}
+
+/**
+ * @brief Launch settings from the jpackage launcher configuration.
+ */
+struct LauncherConfig {
+	std::vector<std::string> classpath;    // app.classpath entries
+	std::string mainClass;                 // app.mainclass
+	std::string mainJar;                   // app.mainjar
+	std::string mainModule;                // app.mainmodule (modular applications)
+	std::vector<std::string> javaOptions;  // [JavaOptions] java-options
+	std::vector<std::string> arguments;    // [ArgOptions] arguments
+};
+
+/**
+ * @brief Converts a UTF-8 string to UTF-16.
+ *
+ * @param text The UTF-8 string.
+ * @return The UTF-16 string.
+ */
+std::wstring utf8ToWide(const std::string& text) {
+	int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), NULL, 0);
+	std::wstring wide(length, L'\0');
+	if (length > 0) {
+		MultiByteToWideChar(CP_UTF8, 0, text.c_str(), static_cast<int>(text.size()), &wide[0], length);
+	}
+	return wide;
+}
+
+/**
+ * @brief Converts a UTF-16 string to a multi-byte code page.
+ *
+ * @param text The UTF-16 string.
+ * @param codePage The code page, e.g. `CP_UTF8` or `CP_ACP`.
+ * @return The converted string; characters missing from the code page are replaced.
+ */
+std::string wideToMultiByte(const std::wstring& text, UINT codePage) {
+	int length = WideCharToMultiByte(codePage, 0, text.c_str(), static_cast<int>(text.size()), NULL, 0, NULL, NULL);
+	std::string converted(length, '\0');
+	if (length > 0) {
+		WideCharToMultiByte(codePage, 0, text.c_str(), static_cast<int>(text.size()), &converted[0], length, NULL, NULL);
+	}
+	return converted;
+}
+
+/**
+ * @brief Replaces the jpackage placeholders in a configuration value.
+ *
+ * The configuration is UTF-8, as written by jpackage, so the directories are
+ * inserted as UTF-8 as well.
+ *
+ * @param value The value.
+ * @param runDir The directory the payload was extracted to.
+ * @return The value with `$APPDIR`, `$ROOTDIR` and `$BINDIR` replaced.
+ */
+std::string expandPlaceholders(std::string value, const std::string& runDir) {
+	const std::pair<std::string, std::string> placeholders[] = {
+		{ "$APPDIR", (fs::path(runDir) / "app").u8string() },
+		{ "$ROOTDIR", fs::path(runDir).u8string() },
+		{ "$BINDIR", fs::path(runDir).u8string() }
+	};
+	for (const auto& placeholder : placeholders) {
+		for (size_t pos = value.find(placeholder.first); pos != std::string::npos; pos = value.find(placeholder.first, pos + placeholder.second.size())) {
+			value.replace(pos, placeholder.first.size(), placeholder.second);
+		}
+	}
+	return value;
+}
+
+/**
+ * @brief Reads the jpackage launcher configuration `app/<name>.cfg`.
+ *
+ * The `$APPDIR`, `$ROOTDIR` and `$BINDIR` placeholders are replaced with the
+ * corresponding directories below the run directory. Class path entries may
+ * be given one per line or, as in older jpackage versions, separated by ';'.
+ * Java options added by `writeLauncherOptions` are skipped.
+ *
+ * @param runDir The directory the payload was extracted to.
+ * @param exeFile The name of the jpackage executable.
+ * @return The launch settings.
+ * @throws std::runtime_error if the configuration cannot be read.
+ */
+LauncherConfig readLauncherConfig(const std::string& runDir, const std::string& exeFile) {
+	const fs::path configPath = fs::path(runDir) / "app" / (fs::path(exeFile).stem().string() + ".cfg");
+	std::ifstream configFile(configPath);
+	if (!configFile.is_open()) {
+		throw std::runtime_error("Failed to open launcher configuration: " + configPath.string());
+	}
+	auto expand = [&](const std::string& value) { return expandPlaceholders(value, runDir); };
+
+	LauncherConfig config;
+	std::string section;
+	std::string line;
+	unsigned long addedOptions = 0;
+	while (std::getline(configFile, line)) {
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		if (line.front() == '[' && line.back() == ']') {
+			section = line.substr(1, line.size() - 2);
+			continue;
+		}
+		size_t separator = line.find('=');
+		if (separator == std::string::npos) {
+			continue;
+		}
+		const std::string key = line.substr(0, separator);
+		const std::string value = expand(line.substr(separator + 1));
+		if (section == "Application") {
+			if (key == "app.classpath") {
+				size_t start = 0;
+				for (size_t end = value.find(';'); start <= value.size(); end = value.find(';', start)) {
+					std::string entry = value.substr(start, end == std::string::npos ? std::string::npos : end - start);
+					if (!entry.empty()) {
+						config.classpath.push_back(entry);
+					}
+					if (end == std::string::npos) {
+						break;
+					}
+					start = end + 1;
+				}
+			} else if (key == "app.mainclass") {
+				config.mainClass = value;
+			} else if (key == "app.mainjar") {
+				config.mainJar = value;
+			} else if (key == "app.mainmodule") {
+				config.mainModule = value;
+			}
+		} else if (section == "JavaOptions" && key == "wjl-options") {
+			addedOptions = strtoul(value.c_str(), NULL, 10);
+		} else if (section == "JavaOptions" && key == "java-options") {
+			if (addedOptions > 0) {
+				--addedOptions;
+			} else {
+				config.javaOptions.push_back(value);
+			}
+		} else if (section == "ArgOptions" && key == "arguments") {
+			config.arguments.push_back(value);
+		}
+	}
+	return config;
+}
+
+/**
+ * @brief Adds JVM options to the jpackage launcher configuration `app/<name>.cfg`.
+ *
+ * The jpackage executable takes its JVM options from its configuration only,
+ * so the options are written to the run directory's copy of it, at the start
+ * of `[JavaOptions]`: the options of the configuration follow and therefore
+ * take precedence. Unlike `JAVA_TOOL_OPTIONS`, they reach only the
+ * application's JVM, not the processes it starts. A `wjl-options` line, which
+ * the jpackage executable ignores, counts the added lines, so that the
+ * options of an earlier launch are replaced. The configuration is replaced
+ * as a whole, and only if it changes.
+ *
+ * @param runDir The directory the payload was extracted to.
+ * @param exeFile The name of the jpackage executable.
+ * @param options The UTF-8 JVM options; empty to remove earlier options.
+ * @return True if the configuration holds the options.
+ */
+bool writeLauncherOptions(const std::string& runDir, const std::string& exeFile, const std::vector<std::string>& options) {
+	const fs::path configPath = fs::path(runDir) / "app" / (fs::path(exeFile).stem().string() + ".cfg");
+	std::string content;
+	{
+		std::ifstream configFile(configPath, std::ios::binary);
+		if (!configFile.is_open()) {
+			return false;
+		}
+		content.assign(std::istreambuf_iterator<char>(configFile), std::istreambuf_iterator<char>());
+	}
+	const std::string newline = content.find("\r\n") != std::string::npos ? "\r\n" : "\n";
+	std::vector<std::string> lines;
+	for (size_t start = 0; start < content.size(); ) {
+		size_t end = content.find('\n', start);
+		if (end == std::string::npos) {
+			end = content.size();
+		}
+		std::string line = content.substr(start, end - start);
+		if (!line.empty() && line.back() == '\r') {
+			line.pop_back();
+		}
+		lines.push_back(line);
+		start = end + 1;
+	}
+
+	// Replace the options of an earlier launch
+	const std::string countKey = "wjl-options=";
+	for (size_t i = 0; i < lines.size(); ++i) {
+		if (lines[i].compare(0, countKey.size(), countKey) == 0) {
+			size_t count = std::min<size_t>(strtoul(lines[i].c_str() + countKey.size(), NULL, 10), lines.size() - i - 1);
+			lines.erase(lines.begin() + i, lines.begin() + i + 1 + count);
+			break;
+		}
+	}
+	if (!options.empty()) {
+		std::vector<std::string> added = { countKey + std::to_string(options.size()) };
+		for (const std::string& option : options) {
+			added.push_back("java-options=" + option);
+		}
+		auto section = std::find(lines.begin(), lines.end(), "[JavaOptions]");
+		if (section == lines.end()) {
+			lines.push_back("[JavaOptions]");
+			section = lines.end() - 1;
+		}
+		lines.insert(section + 1, added.begin(), added.end());
+	}
+	std::string updated;
+	for (const std::string& line : lines) {
+		updated += line + newline;
+	}
+	if (updated == content) {
+		return true;
+	}
+
+	// A concurrent launch reads either the old or the new configuration
+	const fs::path tempPath = configPath.wstring() + L"." + std::to_wstring(GetCurrentProcessId());
+	{
+		std::ofstream tempFile(tempPath, std::ios::binary | std::ios::trunc);
+		if (!tempFile.write(updated.data(), static_cast<std::streamsize>(updated.size()))) {
+			tempFile.close();
+			std::error_code ec;
+			fs::remove(tempPath, ec);
+			return false;
+		}
+	}
+	if (!MoveFileExW(tempPath.c_str(), configPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		std::error_code ec;
+		fs::remove(tempPath, ec);
+		return false;
+	}
+	DEBUG_LOG("JVM options added to " + configPath.string() + ": " + std::to_string(options.size()));
+	return true;
+}
+
+/**
+ * @brief Returns the command-line arguments to pass on to the application.
+ *
+ * The arguments are taken from the wide command line, so they reach the
+ * application unchanged whatever the code page. The launcher's own
+ * `--wjl-*` switches are removed.
+ *
+ * @return The arguments, without the program name.
+ */
+std::vector<std::wstring> getForwardedArguments() {
+	std::vector<std::wstring> arguments;
+	int count = 0;
+	LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &count);
+	if (argv == NULL) {
+		return arguments;
+	}
+	for (int i = 1; i < count; ++i) {
+		if (wcsncmp(argv[i], L"--wjl-", 6) != 0) {
+			arguments.push_back(argv[i]);
+		}
+	}
+	LocalFree(argv);
+	return arguments;
+}
+
+/**
+ * @brief Reads the JVM options of the tuning profile (`TUNING_PROFILE`).
+ *
+ * The profile is the text resource `IDR_TUNING_PROFILE` with one option per
+ * line; empty lines and lines starting with '#' are skipped, and the
+ * placeholders of the jpackage configuration (e.g. `$APPDIR`) are replaced.
+ *
+ * @param runDir The directory the payload was extracted to.
+ * @return The JVM options; empty without a tuning profile.
+ */
+std::vector<std::string> getTuningProfile(const std::string& runDir) {
+	std::vector<std::string> options;
+	const ResourceView profile = TUNING_PROFILE ? getResourceView(IDR_TUNING_PROFILE) : ResourceView();
+	if (!profile) {
+		return options;
+	}
+	const char* text = static_cast<const char*>(profile.data);
+	for (size_t start = 0; start < profile.size; ) {
+		size_t end = start;
+		while (end < profile.size && text[end] != '\n') {
+			++end;
+		}
+		std::string line(text + start, end - start);
+		start = end + 1;
+		size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
+		}
+		line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+		options.push_back(expandPlaceholders(line, runDir));
+		DEBUG_LOG("Tuning profile option: " + options.back());
+	}
+	return options;
+}
+
+/**
+ * @brief Quotes a command-line argument so that `CommandLineToArgvW` reads it back unchanged.
+ *
+ * @param argument The argument.
+ * @return The argument, quoted if it is empty or contains spaces or quotes.
+ */
+std::wstring quoteArgument(const std::wstring& argument) {
+	if (!argument.empty() && argument.find_first_of(L" \t\n\v\"") == std::wstring::npos) {
+		return argument;
+	}
+	std::wstring quoted = L"\"";
+	size_t backslashes = 0;
+	for (wchar_t c : argument) {
+		if (c == L'\\') {
+			++backslashes;
+			continue;
+		}
+		// Backslashes are literal unless they precede a quote
+		quoted.append(c == L'"' ? backslashes * 2 + 1 : backslashes, L'\\');
+		quoted.push_back(c);
+		backslashes = 0;
+	}
+	quoted.append(backslashes * 2, L'\\');
+	quoted.push_back(L'"');
+	return quoted;
+}
+
+/**
+ * @brief Starts the jpackage executable with the launcher's arguments and standard handles.
+ *
+ * The command-line arguments of the launcher (see `getForwardedArguments`)
+ * are passed on, and the process inherits the environment. If the launcher
+ * was started with standard handles (e.g. redirected to files or pipes),
+ * inheritable duplicates of them become the standard handles of the process;
+ * `PROC_THREAD_ATTRIBUTE_HANDLE_LIST` restricts the inheritance to these
+ * handles, so no other handle of the launcher leaks into the application.
+ *
+ * @param runDir The directory the payload was extracted to.
+ * @param exeFile The name of the jpackage executable.
+ * @param pi Receives the process information.
+ * @param suspended True to start the process suspended, e.g. to apply the process limits first.
+ * @return True if the process was started, false otherwise.
+ */
+bool startApplicationProcess(const std::string& runDir, const std::string& exeFile, PROCESS_INFORMATION& pi, bool suspended) {
+	const std::wstring exePath = (fs::path(runDir) / exeFile).wstring();
+	std::wstring commandLine = quoteArgument(exePath);
+	for (const std::wstring& argument : getForwardedArguments()) {
+		commandLine += L" " + quoteArgument(argument);
+	}
+
+	STARTUPINFOEXW si;
+	memset(&si, 0, sizeof(si));
+	si.StartupInfo.cb = sizeof(si);
+	HANDLE stdHandles[3] = { NULL, NULL, NULL };
+	std::vector<HANDLE> inherited;
+	const DWORD stdHandleIDs[3] = { STD_INPUT_HANDLE, STD_OUTPUT_HANDLE, STD_ERROR_HANDLE };
+	for (int i = 0; i < 3; ++i) {
+		HANDLE handle = GetStdHandle(stdHandleIDs[i]);
+		if (handle != NULL && handle != INVALID_HANDLE_VALUE &&
+			DuplicateHandle(GetCurrentProcess(), handle, GetCurrentProcess(), &stdHandles[i], 0, TRUE, DUPLICATE_SAME_ACCESS)) {
+			inherited.push_back(stdHandles[i]);
+		}
+	}
+
+	std::vector<char> attributeBuffer;
+	LPPROC_THREAD_ATTRIBUTE_LIST attributes = NULL;
+	if (!inherited.empty()) {
+		SIZE_T attributeSize = 0;
+		InitializeProcThreadAttributeList(NULL, 1, 0, &attributeSize);
+		attributeBuffer.resize(attributeSize);
+		attributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributeBuffer.data());
+		if (!InitializeProcThreadAttributeList(attributes, 1, 0, &attributeSize)) {
+			attributes = NULL;
+		} else if (!UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, inherited.data(), inherited.size() * sizeof(HANDLE), NULL, NULL)) {
+			DeleteProcThreadAttributeList(attributes);
+			attributes = NULL;
+		}
+	}
+	if (attributes != NULL) {
+		si.lpAttributeList = attributes;
+		si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+		si.StartupInfo.hStdInput = stdHandles[0];
+		si.StartupInfo.hStdOutput = stdHandles[1];
+		si.StartupInfo.hStdError = stdHandles[2];
+		DEBUG_LOG("Passing " + std::to_string(inherited.size()) + " standard handles to the application.");
+	}
+
+	const std::wstring workingDir = fs::path(runDir).wstring();
+	BOOL started = CreateProcessW(
+		exePath.c_str(),                // Path to the executable
+		&commandLine[0],                // Executable and forwarded arguments
+		NULL,                           // Default security attributes
+		NULL,                           // Default thread security attributes
+		attributes != NULL,             // Inherit the standard handles only
+		CREATE_NO_WINDOW | (attributes != NULL ? EXTENDED_STARTUPINFO_PRESENT : 0) | (suspended ? CREATE_SUSPENDED : 0),
+		NULL,                           // Use the parent's environment
+		workingDir.c_str(),             // Working directory
+		&si.StartupInfo,                // Startup information
+		&pi);                           // Process information
+	DWORD error = GetLastError();
+	if (attributes != NULL) {
+		DeleteProcThreadAttributeList(attributes);
+	}
+	for (HANDLE handle : inherited) {
+		CloseHandle(handle);
+	}
+	SetLastError(error);
+	return started != FALSE;
+}
+
+/**
+ * @brief Limits and scheduling hints for the application (`IDS_PROCESS_LIMITS`).
+ */
+struct ProcessLimits {
+	mz_uint64 memoryLimit = 0;     // Committed memory of the job in bytes, 0 for no limit
+	DWORD cpuRate = 0;             // Hard cap in 1/100 percent of all processors, 0 for no limit
+	DWORD_PTR affinity = 0;        // Processor mask, 0 to keep the launcher's
+	DWORD priorityClass = 0;       // Priority class, 0 to keep the default
+	bool killOnClose = false;      // Terminate the processes of the job when the launcher exits
+	bool ecoQoS = false;           // Run in efficiency mode (EcoQoS)
+
+	bool needsJob() const {
+		return memoryLimit > 0 || cpuRate > 0 || killOnClose;
+	}
+
+	bool empty() const {
+		return !needsJob() && affinity == 0 && priorityClass == 0 && !ecoQoS;
+	}
+};
+
+/**
+ * @brief Reads the process limits of the application.
+ *
+ * The limits are a semicolon-separated list of `key=value` items, e.g.
+ * `memory=2048;cpu=50;affinity=0x0F;priority=below_normal;killonclose=1;ecoqos=1`:
+ *
+ * - `memory`: limit of the committed memory of all processes in MB
+ * - `cpu`: hard cap of the CPU usage in percent of all processors
+ * - `affinity`: mask of the processors to run on
+ * - `priority`: `idle`, `below_normal`, `normal`, `above_normal` or `high`
+ * - `killonclose`: 1 to terminate the processes left when the launcher exits
+ * - `ecoqos`: 1 to run in efficiency mode
+ *
+ * A file next to the launcher with the extension `PROCESS_LIMITS_EXTENSION`
+ * (one or more items per line, lines starting with '#' are skipped) takes
+ * precedence over the string resource `IDS_PROCESS_LIMITS`, so the limits of
+ * a host can be changed without rebuilding the launcher. Invalid items are
+ * reported and ignored.
+ *
+ * @return The process limits; empty if none are configured.
+ */
+ProcessLimits getProcessLimits() {
+	std::vector<std::string> items;
+	bool fromFile = false;
+	wchar_t exePath[MAX_PATH];
+	DWORD length = GetModuleFileNameW(NULL, exePath, MAX_PATH);
+	if (length > 0 && length < MAX_PATH) {
+		const fs::path limitsPath = fs::path(exePath).replace_extension(PROCESS_LIMITS_EXTENSION);
+		std::ifstream file(limitsPath);
+		if (file) {
+			std::string line, list;
+			while (std::getline(file, line)) {
+				size_t first = line.find_first_not_of(" \t\r");
+				if (first != std::string::npos && line[first] != '#') {
+					list += line + ";";
+				}
+			}
+			std::replace(list.begin(), list.end(), '\r', ';');
+			items = splitList(list);
+			fromFile = true;
+			DEBUG_LOG("Process limits read from " + limitsPath.string());
+		}
+	}
+	if (!fromFile) {
+		items = getStringList(IDS_PROCESS_LIMITS);
+	}
+
+	ProcessLimits limits;
+	for (const std::string& item : items) {
+		size_t equals = item.find('=');
+		std::string key = item.substr(0, equals);
+		std::transform(key.begin(), key.end(), key.begin(), [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+		key.erase(key.find_last_not_of(" \t") + 1);
+		std::string value = equals == std::string::npos ? "" : item.substr(equals + 1);
+		value.erase(0, value.find_first_not_of(" \t"));
+		std::transform(value.begin(), value.end(), value.begin(), [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); });
+
+		char* end = NULL;
+		unsigned long long number = value.empty() ? 0 : strtoull(value.c_str(), &end, 0);
+		bool numeric = !value.empty() && *end == '\0';
+		bool valid = true;
+		if (key == "memory" && numeric) {
+			limits.memoryLimit = static_cast<mz_uint64>(number) * 1024 * 1024;
+		} else if (key == "cpu" && numeric && number <= 100) {
+			limits.cpuRate = static_cast<DWORD>(number * 100);
+		} else if (key == "affinity" && numeric) {
+			limits.affinity = static_cast<DWORD_PTR>(number);
+		} else if (key == "killonclose" && numeric) {
+			limits.killOnClose = number != 0;
+		} else if (key == "ecoqos" && numeric) {
+			limits.ecoQoS = number != 0;
+		} else if (key == "priority") {
+			const std::pair<const char*, DWORD> classes[] = {
+				{ "idle", IDLE_PRIORITY_CLASS }, { "below_normal", BELOW_NORMAL_PRIORITY_CLASS },
+				{ "normal", NORMAL_PRIORITY_CLASS }, { "above_normal", ABOVE_NORMAL_PRIORITY_CLASS },
+				{ "high", HIGH_PRIORITY_CLASS } };
+			valid = false;
+			for (const auto& priorityClass : classes) {
+				if (value == priorityClass.first) {
+					limits.priorityClass = priorityClass.second;
+					valid = true;
+				}
+			}
+		} else {
+			valid = false;
+		}
+		if (!valid) {
+			printErrorInfo("Invalid process limit ignored: " + item);
+		}
+	}
+	return limits;
+}
+
+/**
+ * @brief Applies the process limits to a process.
+ *
+ * The memory limit, the CPU rate and kill-on-close are limits of a job
+ * object the process is assigned to; the job allows breaking away, so the
+ * cleanup processes of the launcher (see `startCleanupProcess`) are not
+ * terminated with it. Priority class, affinity and EcoQoS are set on the
+ * process itself, and are inherited by the processes it starts. Settings
+ * that cannot be applied, e.g. because the launcher runs in a job that
+ * forbids them, are reported and skipped.
+ *
+ * @param limits The process limits.
+ * @param process The process handle; a suspended process is resumed by the caller.
+ * @param job The job handle, created if it is NULL and a job is needed;
+ *            if it is not NULL, the process is already in the job.
+ */
+void applyProcessLimits(const ProcessLimits& limits, HANDLE process, HANDLE& job) {
+	if (job == NULL && limits.needsJob()) {
+		job = CreateJobObjectW(NULL, NULL);
+		if (job != NULL) {
+			JOBOBJECT_EXTENDED_LIMIT_INFORMATION info;
+			memset(&info, 0, sizeof(info));
+			info.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_BREAKAWAY_OK;
+			if (limits.killOnClose) {
+				info.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+			}
+			if (limits.memoryLimit > 0) {
+				info.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_JOB_MEMORY;
+				info.JobMemoryLimit = static_cast<SIZE_T>(limits.memoryLimit);
+			}
+			bool configured = SetInformationJobObject(job, JobObjectExtendedLimitInformation, &info, sizeof(info)) != FALSE;
+			if (configured && limits.cpuRate > 0) {
+				JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate;
+				memset(&rate, 0, sizeof(rate));
+				rate.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE | JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+				rate.CpuRate = limits.cpuRate;
+				if (!SetInformationJobObject(job, JobObjectCpuRateControlInformation, &rate, sizeof(rate))) {
+					printErrorInfo("Failed to set the CPU rate of the job. Error Code: " + std::to_string(GetLastError()));
+				}
+			}
+			if (!configured || !AssignProcessToJobObject(job, process)) {
+				printErrorInfo("Failed to assign the application to a job. Error Code: " + std::to_string(GetLastError()));
+				CloseHandle(job);
+				job = NULL;
+			} else {
+				DEBUG_LOG("Application assigned to a job object.");
+			}
+		} else {
+			printErrorInfo("Failed to create a job object. Error Code: " + std::to_string(GetLastError()));
+		}
+	}
+	if (limits.priorityClass != 0 && !SetPriorityClass(process, limits.priorityClass)) {
+		printErrorInfo("Failed to set the priority class. Error Code: " + std::to_string(GetLastError()));
+	}
+	if (limits.affinity != 0) {
+		DWORD_PTR processMask = 0;
+		DWORD_PTR systemMask = 0;
+		if (!GetProcessAffinityMask(process, &processMask, &systemMask) || (limits.affinity & systemMask) == 0 ||
+			!SetProcessAffinityMask(process, limits.affinity & systemMask)) {
+			printErrorInfo("Failed to set the processor affinity. Error Code: " + std::to_string(GetLastError()));
+		}
+	}
+	if (limits.ecoQoS) {
+		// SetProcessInformation(ProcessPowerThrottling) exists from Windows 10 1709 on
+		typedef BOOL (WINAPI *SetProcessInformation_t)(HANDLE, int, LPVOID, DWORD);
+		SetProcessInformation_t setProcessInformation = reinterpret_cast<SetProcessInformation_t>(
+			reinterpret_cast<void*>(GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "SetProcessInformation")));
+		// PROCESS_POWER_THROTTLING_STATE: current version, throttle the execution speed
+		struct { ULONG version; ULONG controlMask; ULONG stateMask; } throttling = { 1, 1, 1 };
+		const int processPowerThrottling = 4;
+		if (setProcessInformation == NULL || !setProcessInformation(process, processPowerThrottling, &throttling, sizeof(throttling))) {
+			printErrorInfo("EcoQoS is not available. Error Code: " + std::to_string(GetLastError()));
+		}
+	}
+}
+
+/**
+ * @brief State of the single-instance mode (`SINGLE_INSTANCE`).
+ */
+struct SingleInstance {
+	HANDLE mutex = NULL;                       // Owned while this is the running instance
+	std::string pipeName;
+	std::atomic<bool> exiting{false};          // The application has exited, hand-offs are refused
+	HANDLE listener = INVALID_HANDLE_VALUE;    // Connection of the application receiving arguments
+	std::vector<std::string> pending;          // Argument frames not yet delivered to the application
+};
+
+/**
+ * @brief Returns the state of the single-instance mode.
+ *
+ * @return The single-instance state.
+ */
+SingleInstance& getSingleInstance() {
+	static SingleInstance instance;
+	return instance;
+}
+
+/**
+ * @brief Reads a line terminated by '\n' from a pipe.
+ *
+ * @param hPipe The pipe handle.
+ * @param line Receives the line without the terminator.
+ * @return True if a complete line was read, false otherwise.
+ */
+bool readPipeLine(HANDLE hPipe, std::string& line) {
+	line.clear();
+	char buffer[4096];
+	DWORD read = 0;
+	while (ReadFile(hPipe, buffer, sizeof(buffer), &read, NULL) && read > 0) {
+		line.append(buffer, read);
+		size_t end = line.find('\n');
+		if (end != std::string::npos) {
+			line.resize(end);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Writes a complete buffer to a pipe.
+ *
+ * @param hPipe The pipe handle.
+ * @param data The data to write.
+ * @return True if all data was written, false otherwise.
+ */
+bool writePipe(HANDLE hPipe, const std::string& data) {
+	DWORD written = 0;
+	return WriteFile(hPipe, data.data(), static_cast<DWORD>(data.size()), &written, NULL) && written == data.size();
+}
+
+/**
+ * @brief Waits for an operation on an overlapped pipe handle.
+ *
+ * An operation that does not complete in time is cancelled.
+ *
+ * @param hPipe The pipe handle, opened with `FILE_FLAG_OVERLAPPED`.
+ * @param overlapped The operation.
+ * @param started The result of the call that started the operation.
+ * @param timeout Time (in ms) to wait for the operation.
+ * @param transferred Receives the number of bytes transferred.
+ * @return True if the operation completed successfully.
+ */
+bool waitPipeOperation(HANDLE hPipe, OVERLAPPED& overlapped, BOOL started, DWORD timeout, DWORD& transferred) {
+	if (!started && GetLastError() != ERROR_IO_PENDING) {
+		return false;
+	}
+	if (!started && WaitForSingleObject(overlapped.hEvent, timeout) != WAIT_OBJECT_0) {
+		CancelIoEx(hPipe, &overlapped);
+	}
+	return GetOverlappedResult(hPipe, &overlapped, &transferred, TRUE) != FALSE;
+}
+
+/**
+ * @brief Reads from an overlapped pipe handle, with a time limit.
+ *
+ * @param hPipe The pipe handle, opened with `FILE_FLAG_OVERLAPPED`.
+ * @param data The data read so far; the bytes read are appended.
+ * @param timeout Time (in ms) to wait for data.
+ * @return True if data was read, false on timeout or error.
+ */
+bool readPipeOverlapped(HANDLE hPipe, std::string& data, DWORD timeout) {
+	char buffer[4096];
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+	DWORD read = 0;
+	bool done = overlapped.hEvent != NULL &&
+		waitPipeOperation(hPipe, overlapped, ReadFile(hPipe, buffer, sizeof(buffer), NULL, &overlapped), timeout, read) && read > 0;
+	if (overlapped.hEvent != NULL) {
+		CloseHandle(overlapped.hEvent);
+	}
+	if (done) {
+		data.append(buffer, read);
+	}
+	return done;
+}
+
+/**
+ * @brief Writes a complete buffer to an overlapped pipe handle, with a time limit.
+ *
+ * @param hPipe The pipe handle, opened with `FILE_FLAG_OVERLAPPED`.
+ * @param data The data to write.
+ * @param timeout Time (in ms) the reader has to take the data.
+ * @return True if all data was written; false on timeout or error, after
+ *         which part of the data may have been written.
+ */
+bool writePipeOverlapped(HANDLE hPipe, const std::string& data, DWORD timeout) {
+	OVERLAPPED overlapped = {};
+	overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+	DWORD written = 0;
+	bool done = overlapped.hEvent != NULL &&
+		waitPipeOperation(hPipe, overlapped, WriteFile(hPipe, data.data(), static_cast<DWORD>(data.size()), NULL, &overlapped), timeout, written) && written == data.size();
+	if (overlapped.hEvent != NULL) {
+		CloseHandle(overlapped.hEvent);
+	}
+	return done;
+}
+
+/**
+ * @brief Appends a 32-bit value to a frame, in big-endian order as read by `DataInput.readInt`.
+ */
+void appendFrameValue(std::string& frame, mz_uint32 value) {
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		frame += static_cast<char>((value >> shift) & 0xFF);
+	}
+}
+
+/**
+ * @brief Reads a 32-bit big-endian value of a frame.
+ */
+mz_uint32 getFrameValue(const std::string& frame, size_t offset) {
+	mz_uint32 value = 0;
+	for (size_t i = 0; i < 4; ++i) {
+		value = (value << 8) | static_cast<unsigned char>(frame[offset + i]);
+	}
+	return value;
+}
+
+/**
+ * @brief Encodes arguments as a frame of the instance pipe.
+ *
+ * The frame holds the number of arguments, followed by the length in bytes
+ * and the UTF-8 bytes of each argument; the numbers are 32-bit big-endian.
+ * Arguments may thus contain any character, including '\n' and '\0'.
+ *
+ * @param arguments The arguments.
+ * @return The frame.
+ */
+std::string encodeArgumentFrame(const std::vector<std::wstring>& arguments) {
+	std::string frame;
+	appendFrameValue(frame, static_cast<mz_uint32>(arguments.size()));
+	for (const std::wstring& argument : arguments) {
+		const std::string utf8 = wideToMultiByte(argument, CP_UTF8);
+		appendFrameValue(frame, static_cast<mz_uint32>(utf8.size()));
+		frame += utf8;
+	}
+	return frame;
+}
+
+/**
+ * @brief Returns the size of the argument frame at the start of the data.
+ *
+ * @param data The data received so far.
+ * @return The size of the frame; 0 if the frame is not complete yet, or
+ *         `std::string::npos` if it exceeds `INSTANCE_FRAME_LIMIT`.
+ */
+size_t getArgumentFrameSize(const std::string& data) {
+	if (data.size() < 4) {
+		return 0;
+	}
+	mz_uint32 count = getFrameValue(data, 0);
+	size_t size = 4;
+	for (mz_uint32 i = 0; i < count; ++i) {
+		if (data.size() < size + 4) {
+			return 0;
+		}
+		size += 4 + getFrameValue(data, size);
+		if (size > INSTANCE_FRAME_LIMIT) {
+			return std::string::npos;
+		}
+	}
+	return data.size() < size ? 0 : size;
+}
+
+/**
+ * @brief Delivers the pending argument frames to the application.
+ *
+ * If the application does not take a frame within `INSTANCE_DELIVERY_TIMEOUT`,
+ * its connection is closed, so that a stuck application cannot block the
+ * pipe server; the frames are kept until it listens again. Only called by the
+ * pipe server thread.
+ */
+void deliverInstanceArguments() {
+	SingleInstance& instance = getSingleInstance();
+	while (instance.listener != INVALID_HANDLE_VALUE && !instance.pending.empty()) {
+		if (!writePipeOverlapped(instance.listener, instance.pending.front(), INSTANCE_DELIVERY_TIMEOUT)) {
+			DEBUG_LOG("Application does not read the instance pipe, arguments kept until it listens again");
+			CloseHandle(instance.listener);
+			instance.listener = INVALID_HANDLE_VALUE;
+			return;
+		}
+		instance.pending.erase(instance.pending.begin());
+	}
+}
+
+/**
+ * @brief Reads the request of a client of the instance pipe.
+ *
+ * @param hPipe The connected pipe instance.
+ * @param command Receives the request line.
+ * @param frame Receives the argument frame of an `ARGS` request.
+ * @return True if a complete request was read within `INSTANCE_PIPE_TIMEOUT`.
+ */
+bool readInstanceRequest(HANDLE hPipe, std::string& command, std::string& frame) {
+	std::string data;
+	size_t end = std::string::npos;
+	while ((end = data.find('\n')) == std::string::npos) {
+		if (data.size() > 16 || !readPipeOverlapped(hPipe, data, INSTANCE_PIPE_TIMEOUT)) {
+			return false;
+		}
+	}
+	command = data.substr(0, end);
+	data.erase(0, end + 1);
+	if (command != "ARGS") {
+		return true;
+	}
+	size_t size = 0;
+	while ((size = getArgumentFrameSize(data)) == 0) {
+		if (!readPipeOverlapped(hPipe, data, INSTANCE_PIPE_TIMEOUT)) {
+			return false;
+		}
+	}
+	if (size == std::string::npos) {
+		return false;
+	}
+	frame = data.substr(0, size);
+	return true;
+}
+
+/**
+ * @brief Serves the instance pipe of the running instance.
+ *
+ * Each client sends a request line: `ARGS` from a second instance, followed
+ * by an argument frame (see `encodeArgumentFrame`), which is answered with
+ * `OK`, or `EXIT` once the application has exited; or `LISTEN` from the
+ * application, whose connection is kept open and receives one argument
+ * frame per hand-off. A second instance gets its answer before the frame is
+ * delivered, and every operation except waiting for a client has a time
+ * limit, so the server stays responsive whatever its clients do.
+ *
+ * @param param Not used.
+ * @return 1 if the pipe cannot be created; otherwise the thread ends with the process.
+ */
+DWORD WINAPI instancePipeThreadProc(LPVOID param) {
+	SingleInstance& instance = getSingleInstance();
+	bool first = true;
+	ULONGLONG deadline = GetTickCount64() + INSTANCE_PIPE_TIMEOUT;
+	for (;;) {
+		// The first instance fails if another process owns the pipe name; the
+		// previous instance may still be exiting
+		HANDLE hPipe = CreateNamedPipeA(instance.pipeName.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+			PIPE_TYPE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, NULL);
+		if (hPipe == INVALID_HANDLE_VALUE && first && GetLastError() == ERROR_ACCESS_DENIED && GetTickCount64() < deadline) {
+			Sleep(50);
+			continue;
+		}
+		if (hPipe == INVALID_HANDLE_VALUE) {
+			printErrorInfo("Failed to create instance pipe. Error Code: " + std::to_string(GetLastError()));
+			return 1;
+		}
+		first = false;
+
+		OVERLAPPED overlapped = {};
+		overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+		DWORD transferred = 0;
+		BOOL connected = ConnectNamedPipe(hPipe, &overlapped);
+		if (!connected && GetLastError() == ERROR_PIPE_CONNECTED) {
+			connected = TRUE;
+		} else {
+			connected = waitPipeOperation(hPipe, overlapped, connected, INFINITE, transferred);
+		}
+		CloseHandle(overlapped.hEvent);
+		std::string command;
+		std::string frame;
+		if (!connected || !readInstanceRequest(hPipe, command, frame)) {
+			CloseHandle(hPipe);
+			continue;
+		}
+		if (command == "LISTEN") {
+			if (instance.listener != INVALID_HANDLE_VALUE) {
+				CloseHandle(instance.listener);
+			}
+			instance.listener = hPipe;
+			deliverInstanceArguments();
+			continue;
+		}
+		if (command == "ARGS") {
+			bool accepted = !instance.exiting;
+			writePipeOverlapped(hPipe, accepted ? "OK\n" : "EXIT\n", INSTANCE_PIPE_TIMEOUT);
+			FlushFileBuffers(hPipe);
+			if (accepted) {
+				DEBUG_LOG("Arguments received from a second instance");
+				instance.pending.push_back(frame);
+				deliverInstanceArguments();
+			}
+		}
+		DisconnectNamedPipe(hPipe);
+		CloseHandle(hPipe);
+	}
+}
+
+/**
+ * @brief Sends the command-line arguments to the running instance.
+ *
+ * The running instance may give the foreground to the application, so that
+ * it can bring its window to the front.
+ *
+ * @param pipeName The name of the instance pipe.
+ * @param refused Set to true if the running instance is exiting.
+ * @return True if the running instance accepted the arguments.
+ */
+bool forwardToRunningInstance(const std::string& pipeName, bool& refused) {
+	const std::string message = "ARGS\n" + encodeArgumentFrame(getForwardedArguments());
+
+	HANDLE hPipe = CreateFileA(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+	if (hPipe == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	AllowSetForegroundWindow(ASFW_ANY);
+	std::string reply;
+	bool sent = writePipe(hPipe, message) && readPipeLine(hPipe, reply);
+	CloseHandle(hPipe);
+	refused = sent && reply == "EXIT";
+	return sent && reply == "OK";
+}
+
+/**
+ * @brief Hands the launch off to a running instance of the application.
+ *
+ * A named mutex, local to the session, marks the running instance. If it is
+ * held by another launcher, the arguments are forwarded to it and true is
+ * returned, so that this launcher exits right away. If the running instance
+ * is exiting, or if it has no instance pipe, the launcher waits until it has
+ * cleaned up (it releases the mutex last), and then becomes the running
+ * instance itself: it serves the instance pipe and tells the application its
+ * name in the `WJL_INSTANCE_PIPE` environment variable.
+ *
+ * @param exeFile The name of the jpackage executable.
+ * @return True if the arguments were handed off and the launcher should exit.
+ */
+bool handOffToRunningInstance(const std::string& exeFile) {
+	SingleInstance& instance = getSingleInstance();
+	const std::string name = "WinJavaLauncher-" + sanitizeFileName(fs::path(exeFile).stem().string());
+	DWORD sessionId = 0;
+	ProcessIdToSessionId(GetCurrentProcessId(), &sessionId);
+	instance.pipeName = "\\\\.\\pipe\\" + name + "-" + std::to_string(sessionId);
+	LONGLONG start = getTimestamp();
+	instance.mutex = CreateMutexA(NULL, TRUE, ("Local\\" + name).c_str());
+	if (instance.mutex == NULL) {
+		printErrorInfo("Failed to create instance mutex. Error Code: " + std::to_string(GetLastError()));
+		return false;
+	}
+
+	if (GetLastError() == ERROR_ALREADY_EXISTS) {
+		ULONGLONG deadline = GetTickCount64() + INSTANCE_PIPE_TIMEOUT;
+		for (;;) {
+			bool refused = false;
+			if (forwardToRunningInstance(instance.pipeName, refused)) {
+				recordTiming("hand_off", instance.pipeName, start);
+				DEBUG_LOG("Arguments handed off to the running instance");
+				CloseHandle(instance.mutex);
+				instance.mutex = NULL;
+				return true;
+			}
+			if (refused) {
+				deadline = GetTickCount64() + INSTANCE_PIPE_TIMEOUT;  // Wait for the running instance to clean up
+			}
+			DWORD wait = WaitForSingleObject(instance.mutex, 50);
+			if (wait == WAIT_OBJECT_0 || wait == WAIT_ABANDONED) {
+				break;  // The previous instance has exited
+			}
+			if (GetTickCount64() > deadline) {
+				printErrorInfo("Running instance not reachable, waiting for it to exit.");
+				WaitForSingleObject(instance.mutex, INFINITE);
+				break;
+			}
+		}
+	}
+
+	// This launcher is the running instance now
+	SetEnvironmentVariableA(INSTANCE_PIPE_VARIABLE, instance.pipeName.c_str());
+	HANDLE hThread = CreateThread(NULL, 0, instancePipeThreadProc, NULL, 0, NULL);
+	if (hThread != NULL) {
+		CloseHandle(hThread);
+	}
+	recordTiming("instance", instance.pipeName, start);
+	return false;
+}
+
+/**
+ * @brief Refuses further hand-offs once the application has exited.
+ */
+void endSingleInstance() {
+	getSingleInstance().exiting = true;
+}
+
+/**
+ * @brief Releases the single-instance mutex once the launcher has cleaned up.
+ */
+void releaseSingleInstance() {
+	SingleInstance& instance = getSingleInstance();
+	if (instance.mutex != NULL) {
+		ReleaseMutex(instance.mutex);
+		CloseHandle(instance.mutex);
+		instance.mutex = NULL;
+	}
+}
+
+/**
+ * @brief Finishes a launch once the application has exited.
  *
- * This function extracts a resource embedded within the executable using
- * Windows resource management functions. Depending on the configuration, it
- * either loads the resource into memory or writes it to a file.
+ * Waits for the deferred extraction, installs the class data sharing archive
+ * of a training launch and deletes the run directory unless it is a cache
+ * directory. If the launcher process itself keeps files of the
+ * runtime loaded (JNI launch), the directory is deleted by a detached process
+ * once the launcher has exited. In single-instance mode, hand-offs are
+ * refused from the start and the instance mutex is released at the end, so
+ * that the next instance does not extract into a directory being deleted.
  *
- * @param resourceID The identifier of the resource to extract.
- * @param resourceBuffer Buffer to store the resource data if extracted into memory (not used).
- * @param outputPath Path to the file where the resource will be saved (optional).
+ * @param runDir The directory the payload was extracted to.
+ * @param deferred The deferred extraction task.
+ * @param runtimeInUse True if the launcher has loaded the runtime's DLLs.
  */
-void extractResource(UINT resourceID, std::vector<char>& resourceBuffer, const std::string& outputPath) {
-	try {
-		DEBUG_LOG("Starting resource extraction. Resource ID: " + std::to_string(resourceID));
+void finishLaunch(const std::string& runDir, BackgroundTask& deferred, bool runtimeInUse) {
+	if (SINGLE_INSTANCE) {
+		endSingleInstance();
+	}
 
-		// Get the current module handle (the executable itself)
-		HMODULE hModule = GetModuleHandle(NULL);
-		if (hModule == NULL) {
-			printErrorInfo("Failed to get module handle!");
-			return;
-		}
-		DEBUG_LOG("Module handle obtained.");
+	// The deferred extraction must be finished before the directory is deleted
+	LONGLONG start = getTimestamp();
+	bool deferredDone = waitBackgroundTask(deferred);
+	recordTiming("wait_deferred", runDir, start);
+	if (!deferredDone) {
+		printErrorInfo("Deferred extraction failed.");
+	}
 
-		HRSRC hResInfo = FindResource(hModule, MAKEINTRESOURCE(resourceID), RT_RCDATA);
-		if (hResInfo == NULL) {
-			printErrorInfo("Resource not found!");
-			return;
-		}
-		DEBUG_LOG("Resource found.");
+	if (USE_APPCDS) {
+		installSharedArchive(runDir);
+	}
 
-		DWORD dwSize = SizeofResource(hModule, hResInfo);
-		if (dwSize == 0) {
-			printErrorInfo("Resource size is 0!");
-			return;
-		}
-		DEBUG_LOG("Resource size determined.");
+	if (!USE_EXTRACTION_CACHE) {
+		// Cleanup: Delete temporary directory
+		DEBUG_LOG("Deleting temporary directory...");
 
-		HGLOBAL hResData = LoadResource(hModule, hResInfo);
-		if (hResData == NULL) {
-			printErrorInfo("Failed to load resource!");
-			return;
+		// Delete the "run" directory
+		start = getTimestamp();
+		fs::path tombstone = (ASYNC_CLEANUP && !runtimeInUse) ? moveToTombstone(runDir) : fs::path();
+		if (!tombstone.empty()) {
+			// Leave the deletion to a detached process and exit right away
+			startTombstonePurge(tombstone.parent_path());
+		} else if (!runtimeInUse || !startDelayedRemoval(runDir)) {
+			deleteFilesAndDirectories("", runDir);
 		}
-		DEBUG_LOG("Resource loaded successfully.");
+		recordTiming("cleanup", runDir, start);
 
-		// Lock the resource and get the pointer to the data
-		const void* pData = LockResource(hResData);
-		if (pData == NULL) {
-			printErrorInfo("Failed to lock resource!");
-			return;
-		}
-		DEBUG_LOG("Resource locked into memory.");
+		// Log completed cleanup
+		DEBUG_LOG("Cleanup completed.");
+	}
 
-		if (IN_MEMORY_EXECUTION) {
-			// In-memory extraction: Store resource data in a buffer (do not write to disk)
-			resourceBuffer.assign(reinterpret_cast<const char*>(pData), reinterpret_cast<const char*>(pData) + dwSize);
-			//data.assign((char*)pData, (char*)pData + dwSize);
-			DEBUG_LOG("Resource loaded into memory. Size: " + std::to_string(dwSize));
-		} else {
-			// Write the resource data (zip or executable) to disk if output path is specified
-			if (outputPath.empty()) {
-				throw std::invalid_argument("No output path specified for disk extraction.");
-			}
+	if (SINGLE_INSTANCE) {
+		releaseSingleInstance();
+	}
+}
 
-			std::ofstream outFile(outputPath, std::ios::binary);
-			if (!outFile.is_open()) {
-				throw std::runtime_error("Failed to open output file for writing.");
-			}
+#ifdef WJL_JNI_LAUNCH
+// Signature of JNI_CreateJavaVM exported by jvm.dll
+typedef jint (JNICALL *JNI_CreateJavaVM_t)(JavaVM**, void**, void*);
 
-			outFile.write(reinterpret_cast<const char*>(pData), dwSize);
-			if (outFile.fail()) {
-				throw std::runtime_error("Failed to write resource to file!");
-			} else {
-				DEBUG_LOG("Resource extracted to " + outputPath);
-			}
-			outFile.close();
-		}
-		DEBUG_LOG("Resource extraction completed.");
-    } catch (const std::exception& e) {
-        printErrorInfo("Error extracting resource: " + std::string(e.what()));
-    }
-}
+/**
+ * @brief State of an in-process launch, shared with the JVM's exit hook.
+ */
+struct JavaLaunch {
+	std::string runDir;
+	BackgroundTask* deferred = NULL;
+	std::vector<std::string> options;    // JavaVMOption strings
+	std::string mainName;                // Main class or main jar
+	jint launchMode = 0;                 // LauncherHelper mode: 1 = class, 2 = jar
+	std::vector<std::wstring> arguments;
+	JNI_CreateJavaVM_t createJavaVM = NULL;
+	bool created = false;                // The JVM was created
+	int exitCode = 0;
+};
 
 /**
- * @brief Extracts the contents of a zip file to a specified directory.
- *
- * This function unzips a zip archive and extracts its contents to a given
- * directory using the `miniz` library. It also cleans up the zip file after extraction.
+ * @brief Returns the state of the in-process launch.
  *
- * @param zipPath Path to the zip file to be extracted.
- * @param extractDir Directory where the zip contents will be extracted.
+ * @return The launch state.
  */
-void unzipFile(const std::string& zipPath, const std::string& extractDir) {
-    mz_zip_archive zip;
-    memset(&zip, 0, sizeof(zip));
-    try {
-		// Open the zip file
-		if (!mz_zip_reader_init_file(&zip, zipPath.c_str(), 0)) {
-			throw std::runtime_error("Error opening zip file: " + zipPath);
-		}
-
-		// Get the number of files in the zip archive
-		int num_files = mz_zip_reader_get_num_files(&zip);
-		if (num_files == 0) {
-			throw std::runtime_error("No files found in the zip archive: " + zipPath);
-		}
-
-		for (int i = 0; i < num_files; ++i) {
-			char filename[512];  // Adjust size as needed
-			mz_uint filenameBufSize = sizeof(filename);
-			if (!mz_zip_reader_get_filename(&zip, i, filename, filenameBufSize)) {
-				throw std::runtime_error("Error getting filename from zip: " + zipPath);
-			}
-			std::string filenameStr(filename);
-			fs::path filePath = fs::path(extractDir) / filename;
-			if (filenameStr.back() == '\\' || filenameStr.back() == '/') {
-				if (!fs::create_directories(filePath)) {
-					throw std::runtime_error("Error creating directory: " + filePath.string());
-				}
-				DEBUG_LOG("Directory created: " + filePath.string());
-			} else {
-				if (!mz_zip_reader_extract_to_file(&zip, i, filePath.string().c_str(), 0)) {
-					throw std::runtime_error("Error extracting file: " + filePath.string());
-				}
-				DEBUG_LOG("Extracted: " + filePath.string());
-			}
-		}
-
-		mz_zip_reader_end(&zip);
-		DEBUG_LOG("Unzip operation completed for: " + zipPath);
-		// Remove the zip file after extraction
-		if (fs::exists(zipPath)) {
-			fs::remove(zipPath);
-			DEBUG_LOG("Zip file removed: " + zipPath);
-		}
-    } catch (const fs::filesystem_error& e) {
-        printErrorInfo("File system error: " + std::string(e.what()));
-    } catch (const std::exception& e) {
-        printErrorInfo("Error during unzip operation: " + std::string(e.what()));
-    }
+JavaLaunch& getJavaLaunch() {
+	static JavaLaunch launch;
+	return launch;
 }
 
 /**
- * @brief Executes a program using in-memory data.
+ * @brief Exit hook of the JVM, called when the application calls `System.exit`.
  *
- * This placeholder function simulates the execution of an application loaded
- * entirely into memory. It demonstrates the intended usage for in-memory execution.
- * It is not implemented!
+ * The JVM terminates the process once the hook returns, so the launch is
+ * finished here instead of after `DestroyJavaVM`.
  *
- * @param exeData Executable data in memory.
- * @param appData Application data in memory.
- * @param runtimeData Runtime data in memory.
- * @return True if execution succeeds, false otherwise.
+ * @param code The exit code of the application.
  */
-bool executeFromMemory(const std::vector<char>& exeData, const std::vector<char>& appData, const std::vector<char>& runtimeData) {
-    // Placeholder function
-    return true;
+void JNICALL javaExitHook(jint code) {
+	JavaLaunch& launch = getJavaLaunch();
+	DEBUG_LOG("Application called System.exit(" + std::to_string(code) + ")");
+	finishLaunch(launch.runDir, *launch.deferred, true);
+	writeTimingReport();
 }
 
 /**
- * @brief Retrieves the executable name from resources.
+ * @brief Creates the JVM and runs the application's main method.
  *
- * This function uses Windows resource management to load a string resource
- * that contains the name of the executable to be launched. The resource ID
- * (IDS_EXECUTABLE) must be defined in the application resources.
+ * Like the `java` launcher, the main class is loaded through
+ * `sun.launcher.LauncherHelper.checkAndLoadMain`, which also reads the
+ * Main-Class of a main jar and supports JavaFX applications without a main
+ * method. If the helper is missing, the main class is loaded directly.
+ * `DestroyJavaVM` returns once all non-daemon threads have ended.
  *
- * @return The name of the executable as a string.
+ * @param param Pointer to the `JavaLaunch` state.
+ * @return Always 0; the result is stored in the launch state.
  */
-std::string getExecutable() {
-    // Get the current module handle
-    HMODULE hModule = GetModuleHandle(NULL);
-    char buffer[MAX_PATH];
-    // Load the resource string
-    if (!LoadStringA(hModule, IDS_EXECUTABLE, buffer, MAX_PATH)) {
-        printErrorInfo("Failed to load executable name resource!");
-    }
-    return std::string(buffer);
+DWORD WINAPI javaMainThreadProc(LPVOID param) {
+	JavaLaunch& launch = *static_cast<JavaLaunch*>(param);
+
+	std::vector<JavaVMOption> options;
+	for (std::string& option : launch.options) {
+		options.push_back({ &option[0], NULL });
+	}
+	options.push_back({ const_cast<char*>("exit"), reinterpret_cast<void*>(&javaExitHook) });
+
+	JavaVMInitArgs vmArgs;
+	vmArgs.version = JNI_VERSION_1_2;
+	vmArgs.nOptions = static_cast<jint>(options.size());
+	vmArgs.options = options.data();
+	vmArgs.ignoreUnrecognized = JNI_FALSE;
+
+	JavaVM* vm = NULL;
+	JNIEnv* env = NULL;
+	LONGLONG start = getTimestamp();
+	if (launch.createJavaVM(&vm, reinterpret_cast<void**>(&env), &vmArgs) != JNI_OK) {
+		printErrorInfo("Failed to create the Java VM.");
+		return 0;
+	}
+	launch.created = true;
+	recordTiming("create_jvm", launch.runDir, start);
+	traceApplicationStart("jni", GetCurrentProcessId());
+
+	start = getTimestamp();
+	jclass mainClass = NULL;
+	jclass helper = env->FindClass("sun/launcher/LauncherHelper");
+	jmethodID checkAndLoadMain = (helper != NULL) ? env->GetStaticMethodID(helper, "checkAndLoadMain", "(ZILjava/lang/String;)Ljava/lang/Class;") : NULL;
+	if (checkAndLoadMain != NULL) {
+		jstring name = env->NewStringUTF(launch.mainName.c_str());
+		mainClass = static_cast<jclass>(env->CallStaticObjectMethod(helper, checkAndLoadMain, JNI_TRUE, launch.launchMode, name));
+	} else if (launch.launchMode == 1) {
+		env->ExceptionClear();
+		std::string className = launch.mainName;
+		std::replace(className.begin(), className.end(), '.', '/');
+		mainClass = env->FindClass(className.c_str());
+	}
+
+	jmethodID mainMethod = (mainClass != NULL) ? env->GetStaticMethodID(mainClass, "main", "([Ljava/lang/String;)V") : NULL;
+	jclass stringClass = env->FindClass("java/lang/String");
+	jobjectArray args = (mainMethod != NULL && stringClass != NULL) ? env->NewObjectArray(static_cast<jsize>(launch.arguments.size()), stringClass, NULL) : NULL;
+	if (args != NULL) {
+		for (size_t i = 0; i < launch.arguments.size(); ++i) {
+			const std::wstring& argument = launch.arguments[i];
+			jstring value = env->NewString(reinterpret_cast<const jchar*>(argument.c_str()), static_cast<jsize>(argument.size()));
+			env->SetObjectArrayElement(args, static_cast<jsize>(i), value);
+			env->DeleteLocalRef(value);
+		}
+		recordTiming("load_main", launch.mainName, start);
+		env->CallStaticVoidMethod(mainClass, mainMethod, args);
+	}
+	if (args == NULL || env->ExceptionCheck()) {
+		if (env->ExceptionCheck()) {
+			env->ExceptionDescribe();
+		} else {
+			printErrorInfo("Failed to load the main class: " + launch.mainName);
+		}
+		launch.exitCode = 1;
+	}
+
+	// Wait for the application's remaining threads (e.g. the event dispatch thread)
+	vm->DetachCurrentThread();
+	vm->DestroyJavaVM();
+	return 0;
 }
 
 /**
- * @brief Retrieves the system's temporary directory.
+ * @brief Runs the application in the launcher process through JNI.
  *
- * This function uses the Windows API (GetTempPath) to retrieve the path of
- * the system's temporary directory. It handles errors by throwing a runtime
- * exception if the temporary directory cannot be retrieved.
+ * Loads `runtime/bin/server/jvm.dll` from the run directory and starts the
+ * main class from the jpackage launcher configuration with its class path,
+ * Java options and arguments, plus the command-line arguments of the
+ * launcher. The JVM runs on a thread of its own, as in the `java` launcher.
  *
- * @return The temporary directory path as a string.
- * @throws std::runtime_error if the temporary directory cannot be retrieved.
+ * Modular applications (`app.mainmodule`) are not supported; for them, and
+ * whenever the JVM cannot be created, false is returned so that the jpackage
+ * executable is started instead.
+ *
+ * @param runDir The directory the payload was extracted to.
+ * @param exeFile The name of the jpackage executable.
+ * @param deferred The deferred extraction task, finished by the exit hook.
+ * @param exitCode Receives the exit code of the application.
+ * @param runtimeInUse Set to true once jvm.dll is loaded into the launcher.
+ * @return True if the application ran in process, false otherwise.
  */
-std::string getTempDirectory() {
-    // Use the OS temporary directory on Windows
-    char tempPath[MAX_PATH];
-    if (GetTempPath(MAX_PATH, tempPath)) {
-        return std::string(tempPath);
-    } else {
-    	printErrorInfo("Failed to get temporary directory.");
-        throw std::runtime_error("Failed to get temporary directory.");
-    }
+bool runJavaInProcess(const std::string& runDir, const std::string& exeFile, BackgroundTask& deferred, int& exitCode, bool& runtimeInUse) {
+	const fs::path runtimeBin = fs::path(runDir) / "runtime" / "bin";
+	const fs::path jvmPath = runtimeBin / "server" / "jvm.dll";
+	JavaLaunch& launch = getJavaLaunch();
+	try {
+		if (!fs::exists(jvmPath)) {
+			throw std::runtime_error("JVM not found: " + jvmPath.string());
+		}
+		LauncherConfig config = readLauncherConfig(runDir, exeFile);
+		if (!config.mainModule.empty()) {
+			throw std::runtime_error("Modular applications are not supported: " + config.mainModule);
+		}
+		if (config.mainClass.empty() && config.mainJar.empty()) {
+			throw std::runtime_error("No main class or main jar in the launcher configuration.");
+		}
+
+		std::string classpath;
+		if (!config.mainJar.empty() && std::find(config.classpath.begin(), config.classpath.end(), config.mainJar) == config.classpath.end()) {
+			config.classpath.insert(config.classpath.begin(), config.mainJar);
+		}
+		for (const std::string& entry : config.classpath) {
+			classpath += (classpath.empty() ? "" : ";") + entry;
+		}
+
+		launch.runDir = runDir;
+		launch.deferred = &deferred;
+		// The configuration is UTF-8, while the JVM reads its options in the
+		// ANSI code page, as converted by the java launcher
+		std::vector<std::string> options = { "-Djava.class.path=" + classpath, "-Djpackage.app-path=" + (fs::path(runDir) / exeFile).u8string(), "-Dsun.java.launcher=SUN_STANDARD" };
+		options.insert(options.end(), config.javaOptions.begin(), config.javaOptions.end());
+		const std::vector<std::string> profile = getTuningProfile(runDir);
+		options.insert(options.end(), profile.begin(), profile.end());
+		const std::string archiveOption = USE_APPCDS ? getSharedArchiveOption(runDir) : "";
+		if (!archiveOption.empty()) {
+			options.push_back(archiveOption);
+		}
+		launch.options.clear();
+		for (const std::string& option : options) {
+			launch.options.push_back(wideToMultiByte(utf8ToWide(option), CP_ACP));
+		}
+		launch.mainName = config.mainClass.empty() ? config.mainJar : config.mainClass;
+		launch.launchMode = config.mainClass.empty() ? 2 : 1;
+		launch.arguments.clear();
+		for (const std::string& argument : config.arguments) {
+			launch.arguments.push_back(utf8ToWide(argument));
+		}
+		std::vector<std::wstring> forwarded = getForwardedArguments();
+		launch.arguments.insert(launch.arguments.end(), forwarded.begin(), forwarded.end());
+	} catch (const std::exception& e) {
+		printErrorInfo("In-process launch not possible: " + std::string(e.what()));
+		return false;
+	}
+
+	// The JVM's dependencies (e.g. the C runtime) are in runtime/bin
+	SetDllDirectoryW(runtimeBin.c_str());
+	LONGLONG start = getTimestamp();
+	HMODULE hJvm = LoadLibraryW(jvmPath.c_str());
+	if (hJvm == NULL) {
+		printErrorInfo("Failed to load " + jvmPath.string() + ". Error Code: " + std::to_string(GetLastError()));
+		return false;
+	}
+	runtimeInUse = true;
+	recordTiming("load_jvm", jvmPath.string(), start);
+	launch.createJavaVM = reinterpret_cast<JNI_CreateJavaVM_t>(reinterpret_cast<void*>(GetProcAddress(hJvm, "JNI_CreateJavaVM")));
+	if (launch.createJavaVM == NULL) {
+		printErrorInfo("JNI_CreateJavaVM not found in " + jvmPath.string());
+		return false;
+	}
+
+	// The application sees the run directory as its working directory, as with CreateProcess
+	SetCurrentDirectoryA(runDir.c_str());
+	recordTiming("startup", "launcher", getTimingLog().origin);
+	HANDLE hThread = CreateThread(NULL, JVM_THREAD_STACK_SIZE, javaMainThreadProc, &launch, STACK_SIZE_PARAM_IS_A_RESERVATION, NULL);
+	if (hThread == NULL) {
+		printErrorInfo("Failed to create the Java main thread. Error Code: " + std::to_string(GetLastError()));
+		return false;
+	}
+	start = getTimestamp();
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	if (!launch.created) {
+		return false;
+	}
+	recordTiming("java_main", launch.mainName, start);
+	exitCode = launch.exitCode;
+	return true;
 }
+#endif // WJL_JNI_LAUNCH
 
 /**
- * @brief Sanitizes a directory or file name by replacing invalid characters.
- *
- * This function sanitizes a string by replacing any character that is not
- * alphanumeric, hyphen, or underscore with an underscore ('_'). This is useful
- * for creating valid filenames or directory names on the filesystem.
+ * @brief Reads a file sequentially so that it ends up in the file cache.
  *
- * @param name The original name to be sanitized.
- * @return A sanitized version of the input name.
+ * @param path The file to read.
+ * @return The number of bytes read; 0 if the file cannot be opened.
  */
-std::string sanitizeFileName(const std::string& name) {
-	std::string sanitizedName = name;
-	// Replace unsafe characters with underscores
-	for (char& ch : sanitizedName) {
-		if (unsafeChars.find(ch) != std::string::npos) {
-			ch = '_';  // Replace unsafe characters with '_'
-		}
+mz_uint64 touchFile(const fs::path& path) {
+	HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE) {
+		return 0;
 	}
-    // Trim any leading or trailing whitespace
-    sanitizedName.erase(0, sanitizedName.find_first_not_of(" \t\n\r\f\v"));
-    sanitizedName.erase(sanitizedName.find_last_not_of(" \t\n\r\f\v") + 1);
-    // Ensure the name is not empty after sanitization
-    if (sanitizedName.empty()) {
-        sanitizedName = "default_name";  // Provide a default name if empty
-    }
-    return sanitizedName;
+	std::vector<char> buffer(OVERLAPPED_BUFFER_SIZE);
+	mz_uint64 total = 0;
+	DWORD read = 0;
+	while (ReadFile(hFile, buffer.data(), static_cast<DWORD>(buffer.size()), &read, NULL) && read > 0) {
+		total += read;
+	}
+	CloseHandle(hFile);
+	return total;
 }
 
 /**
- * @brief Retrieves the run directory path for extraction or execution.
+ * @brief Runs the prewarm mode (`--wjl-prewarm`).
  *
- * This function calculates the directory where the executable's resources
- * will be extracted. If the `USE_TEMP_DIRECTORY` flag is set, it returns
- * a temporary directory. Otherwise, it returns the directory containing
- * the executable file (minus the file extension), ensuring that any invalid
- * characters in the path are sanitized.
+ * Meant for a scheduled task at logon or after an update: the pages of the
+ * embedded payload are read, which every launch hashes or extracts, and with
+ * `USE_EXTRACTION_CACHE` the cache directory of the payload is populated
+ * (or refreshed, pruning the directories of previous versions), then the
+ * files the JVM starts from are read (see `PREWARM_FILES`). The next launch
+ * thus only finds the completion marker and starts the application from
+ * files in the standby list.
  *
- * @param exeFile The full path of the executable file.
- * @return The full path of the directory where the executable's resources
- *         will be extracted or executed from.
+ * The launcher runs at idle priority, but not in background mode, which
+ * would give the pages it reads a low memory priority and let them be
+ * repurposed first.
+ *
+ * @param exeFile The name of the jpackage executable.
+ * @return The exit code: 0 on success, 1 if the cache could not be populated.
  */
-std::string getRunDirectory(const std::string& exeFile) {
-
-	// Use fs::path for better path handling
-	fs::path exePath(exeFile);
-
-	// Remove the extension and get the base name
-	fs::path baseName = exePath.stem();  // 'stem' removes the file extension
-	std::string sanitizedBaseName = sanitizeFileName(baseName.string());
-	DEBUG_LOG("Sanitized directory: " + sanitizedBaseName);
+int runPrewarm(const std::string& exeFile) {
+	SetPriorityClass(GetCurrentProcess(), IDLE_PRIORITY_CLASS);
 
-    // Determine the parent directory
-    fs::path parentPath;
-    try {
-		if (USE_TEMP_DIRECTORY) {
-			// Use the system temp directory
-			parentPath = getTempDirectory();
-			// Fallback if temp directory acquisition fails
-			if (parentPath.empty()) {
-				printErrorInfo("Temp directory acquisition failed, falling back to executable directory.");
-				// Parent directory of the executable
-				parentPath = exePath.parent_path();
-			}
-		} else {
-			// Fallback to the current location of the executable
-			parentPath = exePath.parent_path();
+	// The payload pages of the launcher image
+	std::vector<UINT> resourceIDs = getRuntimeResources();
+	resourceIDs.insert(resourceIDs.begin(), IDR_APP_CONTENTS);
+	resourceIDs.push_back(IDR_APP_EXECUTABLE);
+	LONGLONG start = getTimestamp();
+	mz_uint64 bytes = 0;
+	volatile mz_uint8 sink = 0;
+	for (UINT resourceID : resourceIDs) {
+		const ResourceView view = getResourceView(resourceID);
+		for (DWORD offset = 0; view && offset < view.size; offset += 4096) {
+			sink = sink + view.bytes()[offset];
 		}
-    } catch (const std::exception& e) {
-    	printErrorInfo("Exception caught while acquiring temp directory: " + std::string(e.what()));
-        // Fall back to the executable directory if temp directory acquisition fails
-		parentPath = exePath.parent_path();
-    }
-    // Combine the parent path with the sanitized directory name
-    fs::path runDir = parentPath / sanitizedBaseName;  // Safer and platform-independent path construction
+		bytes += view.size;
+	}
+	recordTiming("prewarm_payload", "launcher", start, bytes, resourceIDs.size());
+	if (!USE_EXTRACTION_CACHE) {
+		DEBUG_LOG("Prewarm without extraction cache: payload read.");
+		return 0;
+	}
 
-    // Create the directory if it doesn't exist (for disk extraction)
-    if (!fs::exists(runDir)) {
-        try {
-            if (!fs::create_directory(runDir)) {
-                throw std::runtime_error("Failed to create directory: " + runDir.string());
-            }
-        } catch (const std::exception& e) {
-        	printErrorInfo("Exception during directory creation: " + std::string(e.what()) + " Path: " + runDir.string());
-			throw std::runtime_error("Failed to create directory: " + runDir.string());
+	std::string cacheDir;
+	try {
+		start = getTimestamp();
+		cacheDir = getCacheDirectory(exeFile, getCacheKey());
+		BackgroundTask deferred;
+		prepareCacheDirectory(exeFile, cacheDir, deferred);
+		if (!waitBackgroundTask(deferred)) {
+			throw std::runtime_error("Deferred extraction failed: " + cacheDir);
 		}
-        DEBUG_LOG("Run directory created: " + runDir.string());
-    }
+		recordTiming("prepare_cache", cacheDir, start);
+		if (pruneCacheDirectories(exeFile, cacheDir) > 0) {
+			// This process is in the background already, so purge right away
+			purgeTombstones(fs::path(cacheDir).parent_path());
+		}
+	} catch (const std::exception& e) {
+		printErrorInfo("Prewarm failed: " + std::string(e.what()));
+		return 1;
+	}
 
-    return runDir.string();
+	// The files the JVM starts from
+	std::vector<fs::path> files;
+	for (const char* file : PREWARM_FILES) {
+		files.push_back(fs::path(cacheDir) / file);
+	}
+	files.push_back(fs::path(cacheDir) / CDS_ARCHIVE_FILE);
+	files.push_back(fs::path(cacheDir) / exeFile);
+	std::error_code ec;
+	for (const auto& entry : fs::recursive_directory_iterator(fs::path(cacheDir) / "app", ec)) {
+		if (entry.is_regular_file(ec)) {
+			files.push_back(entry.path());
+		}
+	}
+	start = getTimestamp();
+	bytes = 0;
+	size_t touched = 0;
+	for (const fs::path& file : files) {
+		mz_uint64 size = touchFile(file);
+		if (size > 0) {
+			bytes += size;
+			++touched;
+		}
+	}
+	recordTiming("prewarm_files", cacheDir, start, bytes, touched);
+	DEBUG_LOG("Prewarm completed: " + std::to_string(touched) + " files read from " + cacheDir);
+	return 0;
 }
 
+// The benchmark harness (src/bench) compiles this file without the entry point
+#ifndef WJL_NO_MAIN
 /**
  * @brief Main entry point of the application.
  *
  * The `main` function handles the initialization, resource extraction, and
- * process execution. It also manages fallback behavior for in-memory execution.
+ * process execution.
  *
- * If the `IN_MEMORY_EXECUTION` flag is set, resources are extracted directly
- * into memory and executed. If not, the resources are extracted to a temporary
- * directory, and the executable is launched from there.
+ * The resources are extracted to a temporary directory, and the executable is
+ * launched from there. If the `TEMPORARY_FILE_EXTRACTION` flag is set, the files are
+ * created as temporary files (a write-back hint to the cache manager). If the
+ * `USE_EXTRACTION_CACHE` flag is set, the extracted directory is kept and
+ * reused by later launches of the same payload, and with `USE_APPCDS` the JVM
+ * maps a class data sharing archive created by the first launch from it. If
+ * the `EARLY_LAUNCH` flag is set, the executable is started once the boot set
+ * is extracted while the remaining entries are extracted in the background.
+ * If the `ASYNC_CLEANUP` flag is set, the run directory is deleted by a
+ * detached process after exit.
+ * If built with `JNI_LAUNCH`, the JVM is hosted in the launcher process and
+ * the jpackage executable is only started if that is not possible. If the
+ * `SINGLE_INSTANCE` flag is set and the application is already running, the
+ * arguments are handed to the running instance and the launcher exits.
+ * The process limits (`IDS_PROCESS_LIMITS`) put the application in a job
+ * object and set its priority, affinity and EcoQoS.
  *
- * @return 0 if successful, 1 otherwise.
+ * Started with `--wjl-purge <dir>`, the launcher only deletes the tombstones
+ * in that directory (see `startTombstonePurge`); started with
+ * `--wjl-remove <dir> <pid>`, it deletes the directory once the process has
+ * exited (see `startDelayedRemoval`). Started with `--wjl-prewarm`, it only
+ * populates the extraction cache and reads the hot files (see `runPrewarm`).
+ * The phases, the cache lookup, the application start and the errors are
+ * written as ETW events (see `initEtw`).
+ *
+ * @return The exit code of the application, or 1 on error.
  */
-int main() {
-
-    if (IN_MEMORY_EXECUTION) {
-        // In-memory extraction
-        std::vector<char> appData;
-        extractResource(IDR_APP_CONTENTS, appData, "");
-
-        std::vector<char> runtimeData;
-        extractResource(IDR_RUNTIME_CONTENTS, runtimeData, "");
+int main(int argc, char* argv[]) {
+    int exitCode = 0;
+    initEtw();
+    if (runCleanupProcess(argc, argv, exitCode)) {
+        return exitCode;
+    }
+    initTiming(argc, argv);
 
-        std::vector<char> exeData;
-        extractResource(IDR_APP_EXECUTABLE, exeData, "");
+    // get jpackage executable
+    std::string exeFile = getExecutable();
+    for (int i = 1; i < argc; ++i) {
+        if (PREWARM_SWITCH == argv[i]) {
+            exitCode = runPrewarm(exeFile);
+            writeTimingReport();
+            return exitCode;
+        }
+    }
+    if (SINGLE_INSTANCE && handOffToRunningInstance(exeFile)) {
+        writeTimingReport();
+        return 0;
+    }
+    std::string runDir;
+    // Deferred extraction of the entries outside the boot set (EARLY_LAUNCH)
+    BackgroundTask deferred;
 
-        // Execute extracted executable from memory
-        if (!executeFromMemory(exeData, appData, runtimeData)) {
-            printErrorInfo("Execution failed.");
+    if (USE_EXTRACTION_CACHE) {
+        // Reuse or populate the versioned cache directory
+        try {
+            LONGLONG start = getTimestamp();
+            std::string cacheDir = getCacheDirectory(exeFile, getCacheKey());
+            runDir = prepareCacheDirectory(exeFile, cacheDir, deferred);
+            recordTiming("prepare_cache", cacheDir, start);
+            if (pruneCacheDirectories(exeFile, cacheDir) > 0 && ASYNC_CLEANUP) {
+                startTombstonePurge(fs::path(cacheDir).parent_path());
+            }
+        } catch (const std::exception& e) {
+            printErrorInfo("Extraction cache failed: " + std::string(e.what()));
+            writeTimingReport();
             return 1;
         }
     } else {
-        // get jpackage executable
-        std::string exeFile = getExecutable();
-    	// Create the directory for the extraction ->
+        // Create the directory for the extraction ->
         // Remove extension from the executable name (assuming .exe extension)
-        std::string runDir = getRunDirectory(exeFile);
+        runDir = getRunDirectory(exeFile);
+        LONGLONG start = getTimestamp();
 
-        // Empty buffer for file extraction
-        std::vector<char> emptyBuf;
+        if (EARLY_LAUNCH) {
+            // Extract the boot set now and the remaining entries while the application starts
+            extractPayload(exeFile, runDir, ExtractionPass::Boot);
+            startBackgroundTask(deferred, [exeFile, runDir]() {
+                return extractPayload(exeFile, runDir, ExtractionPass::Deferred);
+            });
+        } else {
+            // Extract the executable and unzip the contents
+            extractPayload(exeFile, runDir);
+        }
+        recordTiming("extract_payload", runDir, start);
+    }
+
+    // Job object, priority, affinity and EcoQoS of the application
+    const ProcessLimits limits = getProcessLimits();
+    HANDLE job = NULL;
+    bool launcherInJob = false;
 
-        // Extract resources and unzip files here...
-        extractResource(IDR_APP_CONTENTS, emptyBuf, runDir + "\\app.zip");
-        extractResource(IDR_RUNTIME_CONTENTS, emptyBuf, runDir + "\\runtime.zip");
-        extractResource(IDR_APP_EXECUTABLE, emptyBuf, runDir + "\\" + exeFile);
+    // Run the application in this process if possible (JNI_LAUNCH)
+    bool runtimeInUse = false;
+#ifdef WJL_JNI_LAUNCH
+    // The JVM runs in the launcher, so the limits apply to the launcher; its
+    // job is closed, and its processes terminated, only when the launcher exits
+    if (!limits.empty()) {
+        applyProcessLimits(limits, GetCurrentProcess(), job);
+        launcherInJob = job != NULL;
+    }
+    bool launched = runJavaInProcess(runDir, exeFile, deferred, exitCode, runtimeInUse);
+#else
+    bool launched = false;
+#endif
 
-        // Unzip ZIPs; they are automatically deleted after extraction
-        unzipFile(runDir + "\\app.zip", runDir);
-        unzipFile(runDir + "\\runtime.zip", runDir);
+    if (!launched) {
+        // JVM options of the tuning profile and the class data sharing archive
+        if (TUNING_PROFILE || USE_APPCDS) {
+            std::vector<std::string> javaOptions = getTuningProfile(runDir);
+            const std::string archiveOption = USE_APPCDS ? getSharedArchiveOption(runDir) : "";
+            if (!archiveOption.empty()) {
+                javaOptions.push_back(archiveOption);
+            }
+            if (!writeLauncherOptions(runDir, exeFile, javaOptions)) {
+                printErrorInfo("Failed to add the JVM options to the launcher configuration of " + runDir);
+            }
+        }
 
-        STARTUPINFO si = {0};
-        si.cb = sizeof(si);
         PROCESS_INFORMATION pi = {0};
 
         // Launch the executable
         std::string fullPath = runDir + "\\" + exeFile;
         // Attempt to launch the process
-        if (CreateProcess(
-                fullPath.c_str(),    // Path to the executable
-                NULL,                // No command-line arguments
-                NULL,                // Default security attributes
-                NULL,                // Default thread security attributes
-                FALSE,               // No inheritance of handles
-                CREATE_NO_WINDOW,    // Ensures no window is created
-                NULL,                // Use the parent's environment
-                runDir.c_str(),      // Working directory
-                &si,                 // Startup information
-                &pi)) {              // Process information
+        recordTiming("startup", "launcher", getTimingLog().origin);
+        LONGLONG start = getTimestamp();
+        if (startApplicationProcess(runDir, exeFile, pi, !limits.empty())) {
+            if (!limits.empty()) {
+                // The process was started suspended, so the limits apply before it runs
+                applyProcessLimits(limits, pi.hProcess, job);
+                ResumeThread(pi.hThread);
+            }
+            recordTiming("create_process", fullPath, start);
+            traceApplicationStart("process", pi.dwProcessId);
             DEBUG_LOG("Process launched successfully: " + fullPath);
+            start = getTimestamp();
             WaitForSingleObject(pi.hProcess, INFINITE);
+            recordTiming("child", fullPath, start);
+            DWORD childExitCode = 0;
+            if (GetExitCodeProcess(pi.hProcess, &childExitCode)) {
+                exitCode = static_cast<int>(childExitCode);
+            }
 
             // Close process and thread handles
             CloseHandle(pi.hProcess);
             CloseHandle(pi.hThread);
         } else {
             printErrorInfo("Failed to launch " + exeFile + ". Error Code: " + std::to_string(GetLastError()));
+            exitCode = 1;
         }
-
-        // Cleanup: Delete temporary directory
-        DEBUG_LOG("Deleting temporary directory...");
-
-        // Delete the "run" directory
-        deleteFilesAndDirectories("", runDir);
-
-        // Log completed cleanup
-        DEBUG_LOG("Cleanup completed.");
+    }
+    // Closing the job terminates the processes left by the application
+    // (killonclose), which may still use files of the run directory
+    if (job != NULL && !launcherInJob) {
+        CloseHandle(job);
     }
 
-    return 0;
+    finishLaunch(runDir, deferred, runtimeInUse);
+
+    writeTimingReport();
+    return exitCode;
 }
+#endif // WJL_NO_MAIN
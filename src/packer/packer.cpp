@@ -0,0 +1,971 @@
+/**
+ * WinJavaLauncher - Payload packer.
+ *
+ * @file packer.cpp
+ * @brief Packs a directory into a deterministic zip archive on all cores.
+ *
+ * This build tool runs on the build machine, not on the target: `make.sh`
+ * compiles it with the host compiler and uses it to write the repacked
+ * payloads. Files are cut into chunks that are deflated independently with
+ * miniz's `tdefl` on a pool of worker threads. Every chunk but the last of a
+ * file ends with a sync flush, so the chunks concatenate to one valid deflate
+ * stream. The archive is written in sorted entry order with fixed timestamps
+ * and attributes, and the chunk boundaries do not depend on the number of
+ * threads: the same input always gives the same archive.
+ *
+ * Files larger than the store threshold and files with one of the store
+ * suffixes are stored, as are files that do not get smaller. An optional
+ * index lists the local header offset, sizes, CRC-32 and method of every
+ * entry, so the offsets can be used without reading the central directory.
+ *
+ *   wjl-pack [options] <directory> <zip>
+ *
+ *   -j <threads>            Worker threads (default: one per core)
+ *   -l <level>              Deflate level, 0-10 (default: 9)
+ *   --chunk-size <KB>       Size of the independently deflated chunks (default: 1024)
+ *   --store-threshold <KB>  Store files larger than this (default: 0, none)
+ *   --store-suffixes <list> Colon-separated suffixes of files to store
+ *   --files <list>          Pack only the entries listed in this file, one
+ *                           path relative to <directory> per line
+ *   --index <file>          Write the entry index to this file
+ *
+ * Archives are limited to 65535 entries and 4 GB (no Zip64).
+ *
+ * With `--make-index`, the packer reads an existing zip archive instead and
+ * writes the binary extraction index the launcher embeds next to it (see
+ * payload_index.h). `--boot-set` takes the boot set patterns (IDS_BOOT_SET
+ * in resources.rc) to assign the files their priority class:
+ *
+ *   wjl-pack --make-index [--boot-set <patterns>] <zip> <index>
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-20
+ * @version 1.0
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "miniz.h"
+#include "../payload_index.h"
+
+namespace fs = std::filesystem;
+
+
+// Default deflate level (0-10, as for mz_zip_writer)
+constexpr int DEFAULT_LEVEL = 9;
+
+// Default chunk size; smaller chunks spread large files over more threads
+// but lose the matches across chunk boundaries
+constexpr size_t DEFAULT_CHUNK_SIZE = 1024 * 1024;
+
+// Chunks in flight per worker thread, which bounds the memory used
+constexpr size_t CHUNKS_PER_THREAD = 4;
+
+// DOS date of all entries (1980-01-01, time 00:00:00)
+constexpr mz_uint16 ENTRY_DOS_DATE = (1 << 5) | 1;
+
+// MS-DOS directory attribute
+constexpr mz_uint32 DOS_DIRECTORY_ATTRIBUTE = 0x10;
+
+// Zip header signatures
+constexpr mz_uint32 ZIP_LOCAL_HEADER_SIG = 0x04034b50;
+constexpr mz_uint32 ZIP_CENTRAL_HEADER_SIG = 0x02014b50;
+constexpr mz_uint32 ZIP_END_OF_CENTRAL_DIR_SIG = 0x06054b50;
+
+
+/**
+ * @brief Options of the packer.
+ */
+struct PackOptions {
+	fs::path sourceDir;
+	fs::path zipFile;
+	fs::path listFile;     // Entries to pack, empty for all
+	fs::path indexFile;    // Index to write, empty for none
+	unsigned threads = 0;  // 0 for one per core
+	int level = DEFAULT_LEVEL;
+	size_t chunkSize = DEFAULT_CHUNK_SIZE;
+	mz_uint64 storeThreshold = 0;  // 0 for no threshold
+	std::vector<std::string> storeSuffixes;
+};
+
+/**
+ * @brief An entry of the archive.
+ */
+struct PackEntry {
+	std::string name;  // Zip entry name, '/'-separated, directories end with '/'
+	fs::path path;
+	bool directory = false;
+	bool store = false;     // Stored by policy, the chunks are not deflated
+	mz_uint64 size = 0;
+	size_t firstChunk = 0;  // Index of the entry's first chunk
+	size_t chunkCount = 0;
+	// Filled in when the entry is written
+	mz_uint64 headerOffset = 0;
+	mz_uint64 compressedSize = 0;
+	mz_uint32 crc = MZ_CRC32_INIT;
+	mz_uint16 method = 0;
+};
+
+/**
+ * @brief A part of a file that is deflated on its own.
+ */
+struct PackChunk {
+	size_t entry;
+	mz_uint64 offset;
+	size_t length;
+	bool last;  // Last chunk of its file, ends the deflate stream
+	// Filled in by the worker
+	bool done = false;
+	std::string error;
+	std::vector<mz_uint8> data;        // Uncompressed data
+	std::vector<mz_uint8> compressed;  // Deflated data, empty if stored by policy
+};
+
+/**
+ * @brief Chunks shared by the worker threads and the writer.
+ */
+struct PackQueue {
+	std::vector<PackChunk> chunks;
+	std::atomic<size_t> next{0};
+	size_t written = 0;  // Chunks written to the archive (and released)
+	size_t window = 0;   // Maximum number of chunks in flight
+	std::mutex mutex;
+	std::condition_variable chunkDone;
+	std::condition_variable chunkWritten;
+};
+
+
+/**
+ * @brief Checks whether a string ends with a suffix.
+ *
+ * @param text The string to check.
+ * @param suffix The suffix.
+ * @return True if `text` ends with `suffix`.
+ */
+bool endsWith(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+/**
+ * @brief Splits a string at a separator, skipping empty parts.
+ *
+ * @param text The string to split.
+ * @param separator The separator.
+ * @return The parts of the string.
+ */
+std::vector<std::string> splitString(const std::string& text, char separator) {
+	std::vector<std::string> parts;
+	size_t start = 0;
+	while (start <= text.size()) {
+		size_t end = text.find(separator, start);
+		if (end == std::string::npos) {
+			end = text.size();
+		}
+		if (end > start) {
+			parts.push_back(text.substr(start, end - start));
+		}
+		start = end + 1;
+	}
+	return parts;
+}
+
+/**
+ * @brief Adds a file or directory to the entries of the archive.
+ *
+ * @param entries The entries of the archive.
+ * @param options The packer options.
+ * @param name Path of the entry relative to the source directory, '/'-separated.
+ */
+void addEntry(std::vector<PackEntry>& entries, const PackOptions& options, std::string name) {
+	while (!name.empty() && name.back() == '/') {
+		name.pop_back();
+	}
+	if (name.empty()) {
+		return;
+	}
+	PackEntry entry;
+	entry.path = options.sourceDir / fs::path(name);
+	if (fs::is_directory(entry.path)) {
+		entry.directory = true;
+		entry.name = name + "/";
+	} else if (fs::is_regular_file(entry.path)) {
+		entry.name = name;
+		entry.size = fs::file_size(entry.path);
+		entry.store = entry.size == 0 || (options.storeThreshold > 0 && entry.size > options.storeThreshold) || options.level == 0;
+		for (const std::string& suffix : options.storeSuffixes) {
+			entry.store = entry.store || endsWith(name, suffix);
+		}
+	} else {
+		throw std::runtime_error("Not a file or directory: " + entry.path.string());
+	}
+	entries.push_back(entry);
+}
+
+/**
+ * @brief Collects the entries to pack, sorted by name.
+ *
+ * @param options The packer options.
+ * @return The entries of the archive.
+ */
+std::vector<PackEntry> collectEntries(const PackOptions& options) {
+	std::vector<PackEntry> entries;
+	if (!options.listFile.empty()) {
+		std::ifstream list(options.listFile);
+		if (!list) {
+			throw std::runtime_error("Failed to open " + options.listFile.string());
+		}
+		std::string line;
+		while (std::getline(list, line)) {
+			if (!line.empty() && line.back() == '\r') {
+				line.pop_back();
+			}
+			addEntry(entries, options, line);
+		}
+	} else {
+		for (const fs::directory_entry& item : fs::recursive_directory_iterator(options.sourceDir)) {
+			addEntry(entries, options, item.path().lexically_relative(options.sourceDir).generic_string());
+		}
+	}
+	// Byte order, as 'LC_ALL=C sort'
+	std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) {
+		return a.name < b.name;
+	});
+	entries.erase(std::unique(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) {
+		return a.name == b.name;
+	}), entries.end());
+	if (entries.size() > 0xFFFF) {
+		throw std::runtime_error("Too many entries for a zip archive without Zip64: " + std::to_string(entries.size()));
+	}
+	return entries;
+}
+
+/**
+ * @brief Appends the output of the deflate compressor to a vector.
+ */
+mz_bool appendDeflateOutput(const void* data, int length, void* user) {
+	std::vector<mz_uint8>* output = static_cast<std::vector<mz_uint8>*>(user);
+	output->insert(output->end(), static_cast<const mz_uint8*>(data), static_cast<const mz_uint8*>(data) + length);
+	return MZ_TRUE;
+}
+
+/**
+ * @brief Reads and deflates one chunk.
+ *
+ * Chunks are independent deflate streams, except that only the last chunk of
+ * a file sets the final block bit. The others end with a sync flush, which
+ * aligns them to a byte boundary.
+ *
+ * @param chunk The chunk.
+ * @param entry The entry the chunk belongs to.
+ * @param compressor Deflate compressor of the worker.
+ * @param flags Deflate compressor flags.
+ */
+void packChunk(PackChunk& chunk, const PackEntry& entry, tdefl_compressor* compressor, int flags) {
+	std::ifstream file(entry.path, std::ios::binary);
+	chunk.data.resize(chunk.length);
+	file.seekg(static_cast<std::streamoff>(chunk.offset));
+	if (!file.read(reinterpret_cast<char*>(chunk.data.data()), static_cast<std::streamsize>(chunk.length))) {
+		throw std::runtime_error("Failed to read " + entry.path.string());
+	}
+	if (entry.store) {
+		return;
+	}
+	chunk.compressed.reserve(chunk.length / 2 + 64);
+	// A finished stream reports TDEFL_STATUS_DONE, a sync flush TDEFL_STATUS_OKAY
+	const tdefl_status expected = chunk.last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY;
+	if (tdefl_init(compressor, appendDeflateOutput, &chunk.compressed, flags) != TDEFL_STATUS_OKAY ||
+		tdefl_compress_buffer(compressor, chunk.data.data(), chunk.length, chunk.last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH) != expected) {
+		throw std::runtime_error("Failed to deflate " + entry.path.string());
+	}
+}
+
+/**
+ * @brief Worker thread: deflates chunks in order until none are left.
+ *
+ * A worker does not start a chunk more than `window` chunks ahead of the
+ * writer, so at most `window` chunks are held in memory.
+ *
+ * @param queue The chunks.
+ * @param entries The entries of the archive.
+ * @param flags Deflate compressor flags.
+ */
+void packWorker(PackQueue& queue, const std::vector<PackEntry>& entries, int flags) {
+	tdefl_compressor* compressor = static_cast<tdefl_compressor*>(malloc(sizeof(tdefl_compressor)));
+	for (;;) {
+		size_t index = queue.next.fetch_add(1);
+		if (index >= queue.chunks.size()) {
+			break;
+		}
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			queue.chunkWritten.wait(lock, [&] { return index < queue.written + queue.window; });
+		}
+		PackChunk& chunk = queue.chunks[index];
+		std::string error;
+		try {
+			if (!compressor) {
+				throw std::runtime_error("Out of memory");
+			}
+			packChunk(chunk, entries[chunk.entry], compressor, flags);
+		} catch (const std::exception& e) {
+			error = e.what();
+		}
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			chunk.error = error;
+			chunk.done = true;
+		}
+		queue.chunkDone.notify_all();
+	}
+	free(compressor);
+}
+
+/**
+ * @brief Little-endian output buffer for zip headers.
+ */
+struct HeaderBuffer {
+	std::vector<mz_uint8> bytes;
+
+	void put16(mz_uint32 value) {
+		bytes.push_back(static_cast<mz_uint8>(value));
+		bytes.push_back(static_cast<mz_uint8>(value >> 8));
+	}
+
+	void put32(mz_uint32 value) {
+		put16(value & 0xFFFF);
+		put16(value >> 16);
+	}
+
+	void putName(const std::string& name) {
+		bytes.insert(bytes.end(), name.begin(), name.end());
+	}
+};
+
+/**
+ * @brief Returns the general purpose flags of an entry (UTF-8 for non-ASCII names).
+ */
+mz_uint16 getEntryFlags(const PackEntry& entry) {
+	for (unsigned char c : entry.name) {
+		if (c >= 0x80) {
+			return 1 << 11;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @brief Builds the local header of an entry.
+ */
+HeaderBuffer makeLocalHeader(const PackEntry& entry) {
+	HeaderBuffer header;
+	header.put32(ZIP_LOCAL_HEADER_SIG);
+	header.put16(20);  // Version needed to extract
+	header.put16(getEntryFlags(entry));
+	header.put16(entry.method);
+	header.put16(0);   // Time
+	header.put16(ENTRY_DOS_DATE);
+	header.put32(entry.crc);
+	header.put32(static_cast<mz_uint32>(entry.compressedSize));
+	header.put32(static_cast<mz_uint32>(entry.size));
+	header.put16(static_cast<mz_uint32>(entry.name.size()));
+	header.put16(0);   // Extra field length
+	header.putName(entry.name);
+	return header;
+}
+
+/**
+ * @brief Appends the central directory header of an entry.
+ */
+void appendCentralHeader(HeaderBuffer& header, const PackEntry& entry) {
+	header.put32(ZIP_CENTRAL_HEADER_SIG);
+	header.put16(20);  // Version made by (MS-DOS)
+	header.put16(20);  // Version needed to extract
+	header.put16(getEntryFlags(entry));
+	header.put16(entry.method);
+	header.put16(0);   // Time
+	header.put16(ENTRY_DOS_DATE);
+	header.put32(entry.crc);
+	header.put32(static_cast<mz_uint32>(entry.compressedSize));
+	header.put32(static_cast<mz_uint32>(entry.size));
+	header.put16(static_cast<mz_uint32>(entry.name.size()));
+	header.put16(0);   // Extra field length
+	header.put16(0);   // Comment length
+	header.put16(0);   // Disk number
+	header.put16(0);   // Internal attributes
+	header.put32(entry.directory ? DOS_DIRECTORY_ATTRIBUTE : 0);
+	header.put32(static_cast<mz_uint32>(entry.headerOffset));
+	header.putName(entry.name);
+}
+
+/**
+ * @brief Writes bytes to the archive.
+ */
+void writeBytes(std::ofstream& zip, const void* data, size_t size, mz_uint64& offset) {
+	if (!zip.write(static_cast<const char*>(data), static_cast<std::streamsize>(size))) {
+		throw std::runtime_error("Failed to write the archive");
+	}
+	offset += size;
+	if (offset > 0xFFFFFFFFull) {
+		throw std::runtime_error("Archive exceeds 4 GB, which requires Zip64");
+	}
+}
+
+/**
+ * @brief Copies the file of an entry to the archive, as stored data.
+ *
+ * @param zip The archive.
+ * @param entry The entry, with the CRC-32 of its chunks.
+ * @param offset Current offset in the archive.
+ * @return The number of bytes copied.
+ * @throws std::runtime_error if the file changed since its chunks were read.
+ */
+mz_uint64 copyFile(std::ofstream& zip, const PackEntry& entry, mz_uint64& offset) {
+	std::ifstream file(entry.path, std::ios::binary);
+	std::vector<char> buffer(DEFAULT_CHUNK_SIZE);
+	mz_uint64 copied = 0;
+	mz_uint32 crc = MZ_CRC32_INIT;
+	while (file.read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || file.gcount() > 0) {
+		const size_t length = static_cast<size_t>(file.gcount());
+		crc = static_cast<mz_uint32>(mz_crc32(crc, reinterpret_cast<const mz_uint8*>(buffer.data()), length));
+		writeBytes(zip, buffer.data(), length, offset);
+		copied += length;
+	}
+	if (copied != entry.size || crc != entry.crc) {
+		throw std::runtime_error("File changed while packing: " + entry.path.string());
+	}
+	return copied;
+}
+
+/**
+ * @brief Writes an entry and its chunks to the archive.
+ *
+ * The local header is written with the sizes and CRC-32 once all chunks are
+ * known; as the chunks are released as soon as they are written, multi-chunk
+ * entries get their header patched afterwards. An entry that does not get
+ * smaller is stored: for a single chunk this is decided before the header is
+ * written, a multi-chunk entry is written again from the file, over its
+ * deflated data.
+ *
+ * @param zip The archive.
+ * @param entry The entry.
+ * @param queue The chunks.
+ * @param offset Current offset in the archive.
+ */
+void writeEntry(std::ofstream& zip, PackEntry& entry, PackQueue& queue, mz_uint64& offset) {
+	entry.headerOffset = offset;
+	entry.method = entry.store || entry.directory ? 0 : MZ_DEFLATED;
+	if (entry.chunkCount == 1) {
+		// Wait for the chunk to decide on the method before writing the header
+		std::unique_lock<std::mutex> lock(queue.mutex);
+		queue.chunkDone.wait(lock, [&] { return queue.chunks[entry.firstChunk].done; });
+		const PackChunk& chunk = queue.chunks[entry.firstChunk];
+		if (entry.method == MZ_DEFLATED && chunk.error.empty() && chunk.compressed.size() >= chunk.data.size()) {
+			entry.method = 0;
+		}
+	}
+	HeaderBuffer header = makeLocalHeader(entry);
+	writeBytes(zip, header.bytes.data(), header.bytes.size(), offset);
+
+	entry.compressedSize = 0;
+	for (size_t i = entry.firstChunk; i < entry.firstChunk + entry.chunkCount; i++) {
+		PackChunk& chunk = queue.chunks[i];
+		{
+			std::unique_lock<std::mutex> lock(queue.mutex);
+			queue.chunkDone.wait(lock, [&] { return chunk.done; });
+		}
+		if (!chunk.error.empty()) {
+			throw std::runtime_error(chunk.error);
+		}
+		entry.crc = static_cast<mz_uint32>(mz_crc32(entry.crc, chunk.data.data(), chunk.data.size()));
+		const std::vector<mz_uint8>& data = entry.method == MZ_DEFLATED ? chunk.compressed : chunk.data;
+		writeBytes(zip, data.data(), data.size(), offset);
+		entry.compressedSize += data.size();
+		std::vector<mz_uint8>().swap(chunk.data);
+		std::vector<mz_uint8>().swap(chunk.compressed);
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.written = i + 1;
+		}
+		queue.chunkWritten.notify_all();
+	}
+	if (entry.method == MZ_DEFLATED && entry.compressedSize >= entry.size) {
+		zip.seekp(static_cast<std::streamoff>(entry.headerOffset + header.bytes.size()));
+		offset = entry.headerOffset + header.bytes.size();
+		entry.method = 0;
+		entry.compressedSize = copyFile(zip, entry, offset);
+	}
+
+	// Patch the sizes and CRC-32 into the local header
+	header = makeLocalHeader(entry);
+	zip.seekp(static_cast<std::streamoff>(entry.headerOffset));
+	zip.write(reinterpret_cast<const char*>(header.bytes.data()), static_cast<std::streamsize>(header.bytes.size()));
+	zip.seekp(static_cast<std::streamoff>(offset));
+	if (!zip) {
+		throw std::runtime_error("Failed to write the archive");
+	}
+}
+
+/**
+ * @brief Writes the index of the archive's entries.
+ *
+ * One line per entry: local header offset, compressed size, size, CRC-32
+ * (hex), method and name, separated by tabs.
+ *
+ * @param indexFile Path of the index.
+ * @param entries The entries of the archive.
+ */
+void writeIndex(const fs::path& indexFile, const std::vector<PackEntry>& entries) {
+	std::ofstream index(indexFile, std::ios::binary | std::ios::trunc);
+	index << "# offset\tcompressed\tsize\tcrc32\tmethod\tname\n";
+	char crc[9];
+	for (const PackEntry& entry : entries) {
+		snprintf(crc, sizeof(crc), "%08lx", static_cast<unsigned long>(entry.crc));
+		index << entry.headerOffset << '\t' << entry.compressedSize << '\t' << entry.size << '\t'
+			<< crc << '\t' << entry.method << '\t' << entry.name << '\n';
+	}
+	if (!index) {
+		throw std::runtime_error("Failed to write " + indexFile.string());
+	}
+}
+
+/**
+ * @brief Packs the source directory into a zip archive.
+ *
+ * @param options The packer options.
+ */
+void pack(const PackOptions& options) {
+	std::vector<PackEntry> entries = collectEntries(options);
+
+	// Cut the files into chunks; stored files are copied in chunks, too
+	PackQueue queue;
+	for (size_t i = 0; i < entries.size(); i++) {
+		PackEntry& entry = entries[i];
+		entry.firstChunk = queue.chunks.size();
+		for (mz_uint64 offset = 0; offset < entry.size; offset += options.chunkSize) {
+			PackChunk chunk;
+			chunk.entry = i;
+			chunk.offset = offset;
+			chunk.length = static_cast<size_t>(std::min<mz_uint64>(options.chunkSize, entry.size - offset));
+			chunk.last = offset + chunk.length == entry.size;
+			queue.chunks.push_back(std::move(chunk));
+		}
+		entry.chunkCount = queue.chunks.size() - entry.firstChunk;
+	}
+
+	unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+	queue.window = static_cast<size_t>(threads) * CHUNKS_PER_THREAD;
+	int flags = static_cast<int>(tdefl_create_comp_flags_from_zip_params(options.level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY));
+
+	std::ofstream zip(options.zipFile, std::ios::binary | std::ios::trunc);
+	if (!zip) {
+		throw std::runtime_error("Failed to create " + options.zipFile.string());
+	}
+	std::vector<std::thread> workers;
+	for (unsigned i = 0; i < threads; i++) {
+		workers.emplace_back(packWorker, std::ref(queue), std::cref(entries), flags);
+	}
+	try {
+		mz_uint64 offset = 0;
+		for (PackEntry& entry : entries) {
+			writeEntry(zip, entry, queue, offset);
+		}
+
+		HeaderBuffer central;
+		for (const PackEntry& entry : entries) {
+			appendCentralHeader(central, entry);
+		}
+		mz_uint64 centralOffset = offset;
+		writeBytes(zip, central.bytes.data(), central.bytes.size(), offset);
+
+		HeaderBuffer end;
+		end.put32(ZIP_END_OF_CENTRAL_DIR_SIG);
+		end.put16(0);  // Disk number
+		end.put16(0);  // Disk of the central directory
+		end.put16(static_cast<mz_uint32>(entries.size()));
+		end.put16(static_cast<mz_uint32>(entries.size()));
+		end.put32(static_cast<mz_uint32>(central.bytes.size()));
+		end.put32(static_cast<mz_uint32>(centralOffset));
+		end.put16(0);  // Comment length
+		writeBytes(zip, end.bytes.data(), end.bytes.size(), offset);
+		zip.close();
+		if (!zip) {
+			throw std::runtime_error("Failed to write " + options.zipFile.string());
+		}
+		// Entries written again as stored leave the end of their deflated data behind
+		fs::resize_file(options.zipFile, offset);
+	} catch (...) {
+		// Let the workers run out before rethrowing
+		queue.next = queue.chunks.size();
+		{
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.written = queue.chunks.size();
+		}
+		queue.chunkWritten.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		throw;
+	}
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	if (!options.indexFile.empty()) {
+		writeIndex(options.indexFile, entries);
+	}
+}
+
+/**
+ * @brief Checks whether a zip entry name matches a boot set pattern.
+ *
+ * Same rules as `matchesPattern` in the launcher: a pattern ending with '/'
+ * matches the names it is a prefix of, otherwise '*' and '?' are wildcards;
+ * the comparison ignores case.
+ *
+ * @param pattern The pattern to match.
+ * @param name The zip entry name, using forward slashes.
+ * @return True if the name matches the pattern.
+ */
+bool matchesPattern(const std::string& pattern, const std::string& name) {
+	auto lower = [](char ch) { return static_cast<char>(std::tolower(static_cast<unsigned char>(ch))); };
+	if (!pattern.empty() && pattern.back() == '/') {
+		return name.size() >= pattern.size() &&
+			std::equal(pattern.begin(), pattern.end(), name.begin(), [&](char a, char b) { return lower(a) == lower(b); });
+	}
+	size_t p = 0, n = 0, star = std::string::npos, mark = 0;
+	while (n < name.size()) {
+		if (p < pattern.size() && (pattern[p] == '?' || lower(pattern[p]) == lower(name[n]))) {
+			++p;
+			++n;
+		} else if (p < pattern.size() && pattern[p] == '*') {
+			star = p++;
+			mark = n;
+		} else if (star != std::string::npos) {
+			p = star + 1;
+			n = ++mark;
+		} else {
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*') {
+		++p;
+	}
+	return p == pattern.size();
+}
+
+/**
+ * @brief Parses the boot set patterns as the launcher does (`getStringList`).
+ *
+ * @param list Semicolon-separated patterns, '!' excludes.
+ * @return The trimmed patterns, with backslashes replaced by slashes.
+ */
+std::vector<std::string> parseBootSet(const std::string& list) {
+	std::vector<std::string> patterns;
+	for (std::string item : splitString(list, ';')) {
+		std::replace(item.begin(), item.end(), '\\', '/');
+		size_t first = item.find_first_not_of(" \t");
+		size_t last = item.find_last_not_of(" \t");
+		if (first != std::string::npos) {
+			patterns.push_back(item.substr(first, last - first + 1));
+		}
+	}
+	return patterns;
+}
+
+/**
+ * @brief Checks whether a zip entry belongs to the boot set (see `isBootEntry` in the launcher).
+ */
+bool isBootEntry(const std::vector<std::string>& patterns, const std::string& name) {
+	bool matched = false;
+	for (const std::string& pattern : patterns) {
+		if (pattern[0] == '!') {
+			if (matchesPattern(pattern.substr(1), name)) {
+				return false;
+			}
+		} else if (!matched && matchesPattern(pattern, name)) {
+			matched = true;
+		}
+	}
+	return matched;
+}
+
+/**
+ * @brief Converts a zip entry name to a relative Windows path.
+ *
+ * @param name The UTF-8 entry name, without a trailing separator.
+ * @return The UTF-16 path with backslashes.
+ * @throws std::runtime_error if the name is not valid UTF-8 or not a safe
+ *         relative path (absolute, drive letter, '..' or empty components).
+ */
+std::vector<mz_uint16> toRelativePath(const std::string& name) {
+	for (const std::string& part : splitString(name, '/')) {
+		if (part == "." || part == "..") {
+			throw std::runtime_error("Unsafe entry name: " + name);
+		}
+	}
+	if (name.empty() || name[0] == '/' || name.find(':') != std::string::npos || name.find("//") != std::string::npos) {
+		throw std::runtime_error("Unsafe entry name: " + name);
+	}
+	std::vector<mz_uint16> path;
+	for (size_t i = 0; i < name.size(); ) {
+		unsigned char c = static_cast<unsigned char>(name[i]);
+		size_t length = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xE ? 3 : (c >> 3) == 0x1E ? 4 : 0;
+		if (length == 0 || i + length > name.size()) {
+			throw std::runtime_error("Entry name is not valid UTF-8: " + name);
+		}
+		mz_uint32 codePoint = length == 1 ? c : c & (0x3F >> (length - 1));
+		for (size_t k = 1; k < length; k++) {
+			unsigned char next = static_cast<unsigned char>(name[i + k]);
+			if ((next >> 6) != 0x2) {
+				throw std::runtime_error("Entry name is not valid UTF-8: " + name);
+			}
+			codePoint = (codePoint << 6) | (next & 0x3F);
+		}
+		i += length;
+		if (codePoint >= 0x10000) {
+			codePoint -= 0x10000;
+			path.push_back(static_cast<mz_uint16>(0xD800 | (codePoint >> 10)));
+			path.push_back(static_cast<mz_uint16>(0xDC00 | (codePoint & 0x3FF)));
+		} else {
+			path.push_back(static_cast<mz_uint16>(codePoint == '/' ? '\\' : codePoint));
+		}
+	}
+	return path;
+}
+
+/**
+ * @brief Writes the binary extraction index of a zip archive.
+ *
+ * @param zipFile The zip archive.
+ * @param indexFile Path of the index.
+ * @param bootSet Boot set patterns (see `parseBootSet`).
+ */
+void makeIndex(const fs::path& zipFile, const fs::path& indexFile, const std::vector<std::string>& bootSet) {
+	const mz_uint16 endianness = 1;
+	if (*reinterpret_cast<const mz_uint8*>(&endianness) != 1) {
+		throw std::runtime_error("The payload index is written on little-endian hosts only");
+	}
+	std::ifstream archive(zipFile, std::ios::binary);
+	const mz_uint64 archiveSize = fs::file_size(zipFile);
+	if (!archive || archiveSize > 0xFFFFFFFFull) {
+		throw std::runtime_error("Cannot index " + zipFile.string());
+	}
+	mz_zip_archive zip;
+	memset(&zip, 0, sizeof(zip));
+	if (!mz_zip_reader_init_file(&zip, zipFile.string().c_str(), 0)) {
+		throw std::runtime_error("Failed to open " + zipFile.string());
+	}
+
+	std::vector<PayloadIndexFile> files;
+	std::vector<std::string> directories;
+	std::vector<mz_uint16> paths;
+	std::string names;
+	auto addPath = [&](const std::string& name, mz_uint32& offset, mz_uint16& length) {
+		std::vector<mz_uint16> path = toRelativePath(name);
+		if (path.size() > 0xFFFF) {
+			throw std::runtime_error("Entry name too long: " + name);
+		}
+		offset = static_cast<mz_uint32>(paths.size());
+		length = static_cast<mz_uint16>(path.size());
+		paths.insert(paths.end(), path.begin(), path.end());
+	};
+	try {
+		for (mz_uint i = 0; i < mz_zip_reader_get_num_files(&zip); i++) {
+			mz_zip_archive_file_stat stat;
+			if (!mz_zip_reader_file_stat(&zip, i, &stat)) {
+				throw std::runtime_error("Failed to read the central directory of " + zipFile.string());
+			}
+			std::string name = stat.m_filename;
+			std::replace(name.begin(), name.end(), '\\', '/');
+			while (!name.empty() && name.back() == '/') {
+				name.pop_back();
+			}
+			// Directories, including the parents of all entries
+			for (size_t pos = name.rfind('/'); pos != std::string::npos && pos > 0; pos = name.rfind('/', pos - 1)) {
+				directories.push_back(name.substr(0, pos));
+			}
+			if (stat.m_is_directory) {
+				directories.push_back(name);
+				continue;
+			}
+
+			// The entry data follows the local header and its name and extra field
+			mz_uint8 header[30];
+			archive.seekg(static_cast<std::streamoff>(stat.m_local_header_ofs));
+			if (!archive.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+				(header[0] | (header[1] << 8) | (header[2] << 16) | ((mz_uint32)header[3] << 24)) != ZIP_LOCAL_HEADER_SIG || (stat.m_bit_flag & 1) != 0) {
+				throw std::runtime_error("Invalid or encrypted entry: " + name);
+			}
+			PayloadIndexFile file = {};
+			file.zipIndex = i;
+			file.dataOffset = static_cast<mz_uint32>(stat.m_local_header_ofs + sizeof(header) + (header[26] | (header[27] << 8)) + (header[28] | (header[29] << 8)));
+			file.compressedSize = static_cast<mz_uint32>(stat.m_comp_size);
+			file.size = static_cast<mz_uint32>(stat.m_uncomp_size);
+			file.crc32 = stat.m_crc32;
+			file.method = static_cast<mz_uint16>(stat.m_method);
+			file.priority = isBootEntry(bootSet, stat.m_filename) ? PAYLOAD_PRIORITY_BOOT : PAYLOAD_PRIORITY_DEFERRED;
+			if (stat.m_uncomp_size > 0xFFFFFFFFull || static_cast<mz_uint64>(file.dataOffset) + file.compressedSize > archiveSize) {
+				throw std::runtime_error("Invalid entry: " + name);
+			}
+			addPath(name, file.pathOffset, file.pathLength);
+			file.nameOffset = static_cast<mz_uint32>(names.size());
+			file.nameLength = static_cast<mz_uint16>(strlen(stat.m_filename));
+			names += stat.m_filename;
+			files.push_back(file);
+		}
+	} catch (...) {
+		mz_zip_reader_end(&zip);
+		throw;
+	}
+	mz_zip_reader_end(&zip);
+
+	// Largest files first, directories by depth, both in a reproducible order
+	std::stable_sort(files.begin(), files.end(), [](const PayloadIndexFile& a, const PayloadIndexFile& b) {
+		return a.size > b.size;
+	});
+	auto depth = [](const std::string& dir) { return std::count(dir.begin(), dir.end(), '/'); };
+	std::sort(directories.begin(), directories.end(), [&](const std::string& a, const std::string& b) {
+		return depth(a) != depth(b) ? depth(a) < depth(b) : a < b;
+	});
+	directories.erase(std::unique(directories.begin(), directories.end()), directories.end());
+	std::vector<PayloadIndexDirectory> directoryRecords;
+	for (const std::string& dir : directories) {
+		PayloadIndexDirectory record = {};
+		addPath(dir, record.pathOffset, record.pathLength);
+		record.depth = static_cast<mz_uint16>(depth(dir));
+		directoryRecords.push_back(record);
+	}
+
+	PayloadIndexHeader header = {};
+	header.magic = PAYLOAD_INDEX_MAGIC;
+	header.version = PAYLOAD_INDEX_VERSION;
+	header.headerSize = sizeof(PayloadIndexHeader);
+	header.archiveSize = static_cast<mz_uint32>(archiveSize);
+	header.fileCount = static_cast<mz_uint32>(files.size());
+	header.directoryCount = static_cast<mz_uint32>(directoryRecords.size());
+	header.pathsLength = static_cast<mz_uint32>(paths.size());
+	header.namesLength = static_cast<mz_uint32>(names.size());
+	std::ofstream index(indexFile, std::ios::binary | std::ios::trunc);
+	index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	index.write(reinterpret_cast<const char*>(files.data()), static_cast<std::streamsize>(files.size() * sizeof(PayloadIndexFile)));
+	index.write(reinterpret_cast<const char*>(directoryRecords.data()), static_cast<std::streamsize>(directoryRecords.size() * sizeof(PayloadIndexDirectory)));
+	index.write(reinterpret_cast<const char*>(paths.data()), static_cast<std::streamsize>(paths.size() * sizeof(mz_uint16)));
+	index.write(names.data(), static_cast<std::streamsize>(names.size()));
+	if (!index) {
+		throw std::runtime_error("Failed to write " + indexFile.string());
+	}
+}
+
+/**
+ * @brief Parses a non-negative number option.
+ *
+ * @param name Name of the option.
+ * @param value Value of the option.
+ * @return The number.
+ */
+unsigned long long parseNumber(const std::string& name, const char* value) {
+	char* end = NULL;
+	unsigned long long number = value ? strtoull(value, &end, 10) : 0;
+	if (!value || *value == '\0' || *end != '\0') {
+		throw std::runtime_error("Invalid value for " + name);
+	}
+	return number;
+}
+
+/**
+ * @brief Main entry point of the packer.
+ */
+int main(int argc, char* argv[]) {
+	try {
+		PackOptions options;
+		std::vector<std::string> paths;
+		bool indexMode = false;
+		std::string bootSet;
+		for (int i = 1; i < argc; i++) {
+			const std::string arg = argv[i];
+			const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+			if (arg == "-j") {
+				options.threads = static_cast<unsigned>(parseNumber(arg, value));
+				i++;
+			} else if (arg == "-l") {
+				options.level = static_cast<int>(std::min(parseNumber(arg, value), 10ull));
+				i++;
+			} else if (arg == "--chunk-size") {
+				options.chunkSize = static_cast<size_t>(std::max(parseNumber(arg, value), 64ull)) * 1024;
+				i++;
+			} else if (arg == "--store-threshold") {
+				options.storeThreshold = parseNumber(arg, value) * 1024;
+				i++;
+			} else if (arg == "--store-suffixes" && value) {
+				options.storeSuffixes = splitString(value, ':');
+				i++;
+			} else if (arg == "--files" && value) {
+				options.listFile = value;
+				i++;
+			} else if (arg == "--index" && value) {
+				options.indexFile = value;
+				i++;
+			} else if (arg == "--make-index") {
+				indexMode = true;
+			} else if (arg == "--boot-set" && value) {
+				bootSet = value;
+				i++;
+			} else if (!arg.empty() && arg[0] == '-') {
+				throw std::runtime_error("Unknown option: " + arg);
+			} else {
+				paths.push_back(arg);
+			}
+		}
+		if (paths.size() != 2) {
+			std::cerr << "Usage: wjl-pack [-j threads] [-l level] [--chunk-size KB] [--store-threshold KB]" << std::endl
+				<< "                [--store-suffixes list] [--files list] [--index file] <directory> <zip>" << std::endl
+				<< "       wjl-pack --make-index [--boot-set patterns] <zip> <index>" << std::endl;
+			return 2;
+		}
+		if (indexMode) {
+			makeIndex(paths[0], paths[1], parseBootSet(bootSet));
+			return 0;
+		}
+		options.sourceDir = paths[0];
+		options.zipFile = paths[1];
+		pack(options);
+		return 0;
+	} catch (const std::exception& e) {
+		std::cerr << "wjl-pack: " << e.what() << std::endl;
+		return 1;
+	}
+}
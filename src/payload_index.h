@@ -0,0 +1,102 @@
+/**
+ * WinJavaLauncher - Payload index format.
+ *
+ * @file payload_index.h
+ * @brief Layout of the extraction index embedded next to a zip payload.
+ *
+ * `wjl-pack --make-index` (src/packer) writes one index per embedded zip
+ * archive, and `make.sh` embeds it as RCDATA resource
+ * `IDR_PAYLOAD_INDEX_BASE + <archive resource ID>` (PAYLOAD_INDEX=1). The
+ * launcher schedules the extraction straight from it: the file records are
+ * sorted by size (largest first), the directories (including the parents of
+ * all entries) by depth, and the paths are relative, checked for `..` and
+ * drive letters, and stored as UTF-16 with backslashes.
+ *
+ * All values are little-endian. The index consists of:
+ *
+ *   PayloadIndexHeader
+ *   PayloadIndexFile[fileCount]
+ *   PayloadIndexDirectory[directoryCount]
+ *   uint16_t paths[pathsLength]  UTF-16 relative paths, not terminated
+ *   char names[namesLength]      UTF-8 zip entry names, not terminated
+ *
+ * @author 2024 autumo Ltd. Switzerland, Michael Gasche
+ * @date 2024-12-21
+ * @version 1.0
+ *
+ * @license MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef WJL_PAYLOAD_INDEX_H
+#define WJL_PAYLOAD_INDEX_H
+
+#include <stdint.h>
+
+// "WJLX" read as a little-endian number
+#define PAYLOAD_INDEX_MAGIC 0x584c4a57
+#define PAYLOAD_INDEX_VERSION 1
+
+// Priority classes of the file records
+#define PAYLOAD_PRIORITY_BOOT 0      // In the boot set (IDS_BOOT_SET)
+#define PAYLOAD_PRIORITY_DEFERRED 1  // Not needed to start the application
+
+/**
+ * @brief Header of a payload index.
+ */
+struct PayloadIndexHeader {
+	uint32_t magic;           // PAYLOAD_INDEX_MAGIC
+	uint16_t version;         // PAYLOAD_INDEX_VERSION
+	uint16_t headerSize;      // sizeof(PayloadIndexHeader)
+	uint32_t archiveSize;     // Size of the zip archive the index belongs to
+	uint32_t fileCount;
+	uint32_t directoryCount;
+	uint32_t pathsLength;     // In UTF-16 code units
+	uint32_t namesLength;     // In bytes
+};
+
+/**
+ * @brief A file of the archive.
+ */
+struct PayloadIndexFile {
+	uint32_t zipIndex;        // Index of the entry in the central directory
+	uint32_t dataOffset;      // Offset of the entry data in the archive
+	uint32_t compressedSize;
+	uint32_t size;
+	uint32_t crc32;
+	uint32_t pathOffset;      // In UTF-16 code units
+	uint32_t nameOffset;      // In bytes
+	uint16_t pathLength;
+	uint16_t nameLength;
+	uint16_t method;          // Zip compression method
+	uint8_t priority;         // PAYLOAD_PRIORITY_*
+	uint8_t reserved;
+};
+
+/**
+ * @brief A directory to create, including the parents of all entries.
+ */
+struct PayloadIndexDirectory {
+	uint32_t pathOffset;      // In UTF-16 code units
+	uint16_t pathLength;
+	uint16_t depth;           // Number of separators in the path
+};
+
+#endif // WJL_PAYLOAD_INDEX_H
@@ -36,3 +36,22 @@
 #define IDR_APP_CONTENTS 101
 #define IDR_RUNTIME_CONTENTS 102
 #define IDR_APP_EXECUTABLE 103
+#define IDS_BOOT_SET 104
+#define IDS_RUNTIME_PROFILE 105
+#define IDR_TUNING_PROFILE 106
+#define IDS_PROCESS_LIMITS 107
+#define IDS_EXTRACTION_ROOT 108
+
+// Runtime modules split off by make.sh (RUNTIME_MODULES): module n is
+// embedded as IDR_RUNTIME_MODULE_FIRST + n and named IDS_RUNTIME_MODULE_FIRST + n
+#define IDR_RUNTIME_MODULE_FIRST 200
+#define IDS_RUNTIME_MODULE_FIRST 300
+#define MAX_RUNTIME_MODULES 32
+
+// CRC-32 of each embedded archive, generated by make.sh (TRUSTED_PAYLOAD):
+// the checksum of resource n is string IDS_RESOURCE_CHECKSUM_BASE + n
+#define IDS_RESOURCE_CHECKSUM_BASE 1000
+
+// Extraction index of each embedded zip archive, generated by make.sh
+// (PAYLOAD_INDEX): the index of resource n is RCDATA IDR_PAYLOAD_INDEX_BASE + n
+#define IDR_PAYLOAD_INDEX_BASE 2000